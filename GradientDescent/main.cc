@@ -3,9 +3,18 @@
 #include <Utils/StopWatch.hh>
 
 #include <Algorithms/GradientDescent.hh>
+#include <Algorithms/AcceleratedGradient.hh>
+#include <Algorithms/NewtonMethod.hh>
+#include <Algorithms/LBFGS.hh>
+#include <Algorithms/NonlinearCG.hh>
+#include <Algorithms/LevenbergMarquardt.hh>
+#include <Algorithms/NewtonCG.hh>
+#include <Algorithms/TrustRegion.hh>
+#include <Algorithms/OverlappingSchwarz.hh>
 #include <Utils/OptimizationStatistic.hh>
 #include <Utils/RandomNumberGenerator.hh>
 #include <MassSpringSystemT.hh>
+#include <MassSpringMultiGridT.hh>
 #include <Utils/DerivativeChecker.hh>
 
 std::vector<AOPT::GradientDescent::Vec> get_start_points(int n_grid_x, int n_grid_y) {
@@ -29,7 +38,82 @@ std::vector<AOPT::GradientDescent::Vec> get_start_points(int n_grid_x, int n_gri
     return start_pts;
 }
 
+// runs the solver selected on the command line, _multigrid and _schwarz being only needed for
+// the multigrid and the Schwarz methods
+AOPT::GradientDescent::Vec solve(const std::string& _solver, AOPT::OptimizationStatistic* _problem,
+                                 AOPT::MassSpringProblem2DSparse* _msp,
+                                 AOPT::MassSpringMultiGridT<AOPT::MassSpringProblem2DSparse>* _multigrid,
+                                 AOPT::OverlappingSchwarz* _schwarz,
+                                 const AOPT::GradientDescent::Vec& _start_point, const int _max_iter) {
+    // Levenberg-Marquardt works on the residuals of the least-squares form of the problem,
+    // whose evaluations are not recorded by the statistic
+    if (_solver == "lm") {
+        if (auto msp_ls = dynamic_cast<AOPT::MassSpringProblem2DLeastSquares*>(_msp))
+            return AOPT::LevenbergMarquardt::solve(msp_ls, _start_point, 1e-4, _max_iter);
+        std::cout << "Error: the problem has no least-squares form, returning the initial point" << std::endl;
+        return _start_point;
+    }
+    // the projected Newton method is Newton's method on the PSD-projected Hessians
+    if (_solver == "newton" || _solver == "projected-newton")
+        return AOPT::NewtonMethod::solve(_problem, _start_point, 1e-4, _max_iter);
+    if (_solver == "newton-cg")
+        return AOPT::NewtonCG::solve(_problem, _start_point, 1e-4, _max_iter);
+    if (_solver == "trust-region")
+        return AOPT::TrustRegion::solve(_problem, _start_point, 1e-4, _max_iter);
+    if (_solver == "multigrid" && _multigrid)
+        return _multigrid->solve(_problem, _start_point, 1e-4, _max_iter);
+    if (_solver == "schwarz" && _schwarz)
+        return _schwarz->solve(_problem, _start_point, 1e-4, _max_iter);
+    if (_solver == "schwarz-additive" && _schwarz)
+        return _schwarz->solve(_problem, _start_point, 1e-4, _max_iter, AOPT::OverlappingSchwarz::ADDITIVE);
+    if (_solver == "lbfgs")
+        return AOPT::LBFGS::solve(_problem, _start_point, 1e-4, _max_iter);
+    if (_solver == "cg")
+        return AOPT::NonlinearCG::solve(_problem, _start_point, 1e-4, _max_iter);
+    if (_solver == "cg-hs")
+        return AOPT::NonlinearCG::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::NonlinearCG::HESTENES_STIEFEL);
+    if (_solver == "cg-exact")
+        return AOPT::NonlinearCG::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::NonlinearCG::POLAK_RIBIERE_PLUS, 0, true);
+    if (_solver == "cg-dy")
+        return AOPT::NonlinearCG::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::NonlinearCG::DAI_YUAN);
+
+    if (_solver == "gd-exact")
+        return AOPT::GradientDescent::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::GradientDescent::EXACT);
+    if (_solver == "gd-speculative")
+        return AOPT::GradientDescent::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::GradientDescent::BACKTRACKING, 10, 4);
+    if (_solver == "gd-nonmonotone")
+        return AOPT::GradientDescent::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::GradientDescent::NONMONOTONE_MAX);
+    if (_solver == "gd-zhang-hager")
+        return AOPT::GradientDescent::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::GradientDescent::NONMONOTONE_AVERAGE);
+    if (_solver == "gd-fixed")
+        return AOPT::GradientDescent::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::GradientDescent::FIXED_STEP);
+    if (_solver == "gd-bb1")
+        return AOPT::GradientDescent::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::GradientDescent::BB1);
+    if (_solver == "gd-bb2")
+        return AOPT::GradientDescent::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::GradientDescent::BB2);
+    if (_solver == "agd")
+        return AOPT::AcceleratedGradient::solve(_problem, _start_point, 1e-4, _max_iter);
+    if (_solver == "agd-fr")
+        return AOPT::AcceleratedGradient::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::AcceleratedGradient::FUNCTION_RESTART);
+    if (_solver == "fista")
+        return AOPT::AcceleratedGradient::solve(_problem, _start_point, 1e-4, _max_iter, AOPT::AcceleratedGradient::NO_RESTART);
+
+    if (_solver != "gd")
+        std::cout << "Warning: unknown solver '" << _solver << "', using the gradient descent" << std::endl;
+    return AOPT::GradientDescent::solve(_problem, _start_point, 1e-4, _max_iter);
+}
+
 int main(int _argc, const char* _argv[]) {
+    // Optional solver selection: gd (default), gd-bb1, gd-bb2 (Barzilai-Borwein steps),
+    // gd-exact (exact line search), gd-speculative (backtracking trial steps evaluated on 4 threads),
+    // gd-nonmonotone, gd-zhang-hager (nonmonotone backtracking against the max or the average of the last f),
+    // gd-fixed (step 1/L with L the largest Hessian eigenvalue at the start point),
+    // agd, agd-fr (accelerated gradient with gradient/function restart), fista (no restart),
+    // newton, projected-newton, lbfgs, cg (Polak-Ribiere+), cg-hs (Hestenes-Stiefel), cg-dy (Dai-Yuan), cg-exact, lm (Levenberg-Marquardt)
+    // newton-cg (truncated Newton), trust-region (Steihaug-CG), multigrid,
+    // schwarz or schwarz-additive (overlapping domain decomposition, multiplicative or additive)
+    const std::string solver = _argc > 1 ? _argv[1] : "gd";
+
     // Set fixed parameters for tests
     int n_grid_x = 8;
     int n_grid_y = 8;
@@ -45,20 +129,34 @@ int main(int _argc, const char* _argv[]) {
             std::string scenario_str = "_scenario_" + std::to_string(scenario);
 
             // Construct the mass-spring system for current function and scenario
-            AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DSparse> mss(n_grid_x, n_grid_y, func_index);
+            // the projected Newton method uses the with-length springs' PSD-projected Hessians
+            const int element_type = (func_index == 1 && solver == "projected-newton") ?
+                    AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DSparse>::WITH_LENGTH_PSD_HESS : func_index;
+            AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DSparse> mss(n_grid_x, n_grid_y, element_type, solver == "lm");
             mss.add_constrained_spring_elements(scenario);
 
+            // coarse levels of the multigrid, with the same springs
+            std::unique_ptr<AOPT::MassSpringMultiGridT<AOPT::MassSpringProblem2DSparse>> multigrid;
+            if (solver == "multigrid")
+                multigrid = std::make_unique<AOPT::MassSpringMultiGridT<AOPT::MassSpringProblem2DSparse>>(
+                        n_grid_x, n_grid_y, element_type, scenario);
+
+            // 4 subdomains partitioned on the grid at rest
+            std::unique_ptr<AOPT::OverlappingSchwarz> schwarz;
+            if (solver == "schwarz" || solver == "schwarz-additive")
+                schwarz = std::make_unique<AOPT::OverlappingSchwarz>(*mss.get_problem(), mss.get_spring_graph_points(), 4);
+
             // Statistic for recording optimization process
             auto opt_stat = std::make_unique<AOPT::OptimizationStatistic>(mss.get_problem().get());
 
             // Generate two start points
             auto start_points = get_start_points(n_grid_x, n_grid_y);
 
-            // Run gradient descent optimization for each start point
+            // Run the optimization for each start point
             for (size_t i = 0; i < start_points.size(); ++i) {
                 mss.set_spring_graph_points(start_points[i]);
                 auto initial_energy = mss.initial_system_energy();
-                std::cout << "\nStarting Gradient Descent with function index " << func_index 
+                std::cout << "\nStarting " << solver << " with function index " << func_index 
                           << ", scenario " << scenario << ", start point " << i + 1 << std::endl;
                 std::cout << "Initial system energy: " << initial_energy << std::endl;
 
@@ -66,9 +164,10 @@ int main(int _argc, const char* _argv[]) {
                 std::string initial_file = filename_prefix + scenario_str + "_start_" + std::to_string(i+1) + "_initial.csv";
                 mss.save_spring_system(initial_file.c_str());
 
-                // Run gradient descent
+                // Run the solver
                 opt_stat->start_recording();
-                AOPT::GradientDescent::Vec optimized_points = AOPT::GradientDescent::solve(opt_stat.get(), start_points[i], 1e-4, max_iter);
+                AOPT::GradientDescent::Vec optimized_points = solve(solver, opt_stat.get(), mss.get_problem().get(), multigrid.get(),
+                                                                    schwarz.get(), start_points[i], max_iter);
                 opt_stat->print_statistics();
 
                 // Set optimized points and calculate final energy
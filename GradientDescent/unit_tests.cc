@@ -1,6 +1,7 @@
 #include <iostream>
 #include <Utils/StopWatch.hh>
 #include <MassSpringSystemT.hh>
+#include <MassSpringMultiGridT.hh>
 #include <Functions/ConstrainedSpringElement2D.hh>
 #include <Functions/FunctionQuadratic2D.hh>
 #include <Functions/FunctionNonConvex2D.hh>
@@ -8,6 +9,20 @@
 #include <Utils/RandomNumberGenerator.hh>
 #include <Utils/DerivativeChecker.hh>
 #include <Algorithms/GradientDescent.hh>
+#include <Algorithms/AcceleratedGradient.hh>
+#include <Algorithms/NewtonMethod.hh>
+#include <Algorithms/LBFGS.hh>
+#include <Algorithms/NonlinearCG.hh>
+#include <Algorithms/LevenbergMarquardt.hh>
+#include <Algorithms/NewtonCG.hh>
+#include <Algorithms/TrustRegion.hh>
+#include <Algorithms/OverlappingSchwarz.hh>
+#include <Functions/FunctionQuadraticND.hh>
+#include <Utils/OptimizationStatistic.hh>
+#include <Utils/LipschitzEstimator.hh>
+
+// counts the heap allocations of the whole test program
+#include <Utils/AllocationCounterHook.hh>
 
 #include "gtest/gtest.h"
 
@@ -65,6 +80,52 @@ public:
 
 
 
+/** Mass spring system on a 6x6 grid with constrained nodes and a perturbed start,
+ * with Newton's minimum from this start, used by the tests of the solvers */
+template<class MassSpringProblem = MassSpringProblem2DSparse>
+class PerturbedMassSpringSystem {
+public:
+    using Vec = typename MassSpringProblem::Vec;
+
+    // constructor
+    PerturbedMassSpringSystem(const int _element_type, const int _scenario = 1, const bool _least_square = false)
+            : mss_(6, 6, _element_type, _least_square) {
+        mss_.add_constrained_spring_elements(_scenario);
+        msp_ = mss_.get_problem();
+
+        x0_ = mss_.get_spring_graph_points();
+        for(int i=0; i<x0_.size(); ++i)
+            x0_[i] += 0.2 * sin(3. * i);
+    }
+
+    MassSpringProblem* problem() { return msp_.get(); }
+
+    const Vec& x0() const { return x0_; }
+
+    // energy of Newton's minimum from x0, computed on the first call
+    double newton_energy() {
+        if(x_newton_.size() == 0)
+            x_newton_ = NewtonMethod::solve(msp_.get(), x0_, 1e-8, 100);
+        return msp_->eval_f(x_newton_);
+    }
+
+    // checks that ||g(_x)|| < _eps and that f(_x) is Newton's minimum energy,
+    // to be called within ASSERT_NO_FATAL_FAILURE
+    void check_minimum(const Vec& _x, const double _eps) {
+        Vec g;
+        msp_->eval_gradient(_x, g);
+        ASSERT_LT(g.norm(), _eps);
+        ASSERT_NEAR(msp_->eval_f(_x), newton_energy(), 1e-8);
+    }
+
+private:
+    MassSpringSystemT<MassSpringProblem> mss_;
+    std::shared_ptr<MassSpringProblem> msp_;
+    Vec x0_, x_newton_;
+};
+
+
+
 /** checks that the basic functions of the ConstrainedSpringElement
  * give the expected results (computed by hand) */
 TEST(ConstrainedSpringElement, CheckFunctions){
@@ -248,6 +309,638 @@ TEST(GradientDescent, CheckAlgorithmOnConstrainedSpringElement){
     ASSERT_NEAR((result-desired_location).norm(), 0, 1e-4);
 }
 
+/** Checks that once warmed up, the evaluations of the sparse MSP and the iterations
+ * of the gradient descent (including its line search) do not allocate memory,
+ * serially and with 2 threads, the latter with the speculative line search */
+TEST(GradientDescent, ZeroAllocationSteadyState){
+    using Vec = MassSpringProblem2DSparse::Vec;
+    using SMat = MassSpringProblem2DSparse::SMat;
+
+    ASSERT_TRUE(AllocationCounter::installed());
+
+    // with more springs than ReproducibleSum::chunk_size, so that the threads also share the energy
+    MassSpringSystemT<MassSpringProblem2DSparse> mss(20, 20, 1);
+    auto msp = mss.get_problem();
+    msp->add_constrained_spring_element(0, 100., 0., 0.);
+    ASSERT_GT(ReproducibleSum::n_chunks(msp->n_springs() + 1), 1u);
+
+    Vec x0 = mss.get_spring_graph_points();
+    for(int i=0; i<x0.size(); ++i)
+        x0[i] += 0.1 * sin(i);
+
+    for(int n_threads : {1, 2}) {
+        msp->set_n_threads(n_threads);
+
+        Vec x = x0, g;
+        SMat H;
+        // warm-up, sizes all the buffers
+        msp->eval_f(x);
+        msp->eval_gradient(x, g);
+        msp->eval_f_and_gradient(x, g);
+        msp->eval_hessian(x, H);
+        msp->reserve_concurrent_eval_f(n_threads);
+
+        long n_allocations = AllocationCounter::n_allocations();
+        for(int i=0; i<100; ++i) {
+            msp->eval_f(x);
+            msp->eval_gradient(x, g);
+            msp->eval_f_and_gradient(x, g);
+            msp->eval_hessian(x, H);
+            msp->eval_f_concurrent(x, n_threads - 1);
+        }
+        ASSERT_EQ(AllocationCounter::n_allocations() - n_allocations, 0) << n_threads << " threads";
+
+        // 100 additional iterations must not allocate anything more than the setup
+        n_allocations = AllocationCounter::n_allocations();
+        GradientDescent::solve(msp.get(), x, 1e-12, 10, GradientDescent::BACKTRACKING, 10, n_threads);
+        const long n_allocations_10 = AllocationCounter::n_allocations() - n_allocations;
+        // x, g, dx, x_new
+        ASSERT_GE(n_allocations_10, 4);
+
+        n_allocations = AllocationCounter::n_allocations();
+        GradientDescent::solve(msp.get(), x, 1e-12, 110, GradientDescent::BACKTRACKING, 10, n_threads);
+        ASSERT_EQ(AllocationCounter::n_allocations() - n_allocations, n_allocations_10) << n_threads << " threads";
+    }
+}
+
+/** Checks that the gradient descent and Newton's method reach bitwise identical points
+ * for any number of threads, i.e. that the gradient and the Hessian, and not only the
+ * energy, do not depend on the number of threads */
+TEST(GradientDescent, ReproducibleParallelRuns){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    // final energies of the gradient descent and of Newton's method with 1, 2 and 4 threads
+    auto check_runs = [](auto& _mss) {
+        _mss.add_constrained_spring_elements(2);
+        auto msp = _mss.get_problem();
+        Vec x0 = _mss.get_spring_graph_points();
+        for(int i=0; i<x0.size(); ++i)
+            x0[i] += 0.2 * sin(3. * i);
+
+        double f_gd(0), f_newton(0);
+        for(int n_threads : {1, 2, 4}) {
+            msp->set_n_threads(n_threads);
+            const double f_gd_threads = msp->eval_f(GradientDescent::solve(msp.get(), x0, 1e-12, 300));
+            const double f_newton_threads = msp->eval_f(NewtonMethod::solve(msp.get(), x0, 1e-12, 5));
+            if(n_threads == 1) {
+                f_gd = f_gd_threads;
+                f_newton = f_newton_threads;
+            }
+            ASSERT_EQ(f_gd_threads, f_gd) << n_threads << " threads";
+            ASSERT_EQ(f_newton_threads, f_newton) << n_threads << " threads";
+        }
+    };
+
+    // 30x30 grids, i.e. several chunks of springs
+    for(int element_type : {0, 1}) {
+        MassSpringSystemT<MassSpringProblem2DSparse> mss(30, 30, element_type);
+        check_runs(mss);
+    }
+    MassSpringSystemT<MassSpringProblem2DSparseT<SpringElement2D>> mss_static(30, 30, 0);
+    check_runs(mss_static);
+    MassSpringSystemT<MassSpringProblem2DSparseT<SpringElement2DWithLength>> mss_static_length(30, 30, 1);
+    check_runs(mss_static_length);
+}
+
+/** Checks that the gradient descent with the Barzilai-Borwein steps reaches Newton's
+ * minimum on a mass spring system, in far fewer iterations than with the backtracking */
+TEST(GradientDescent, CheckBarzilaiBorweinStepsOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    PerturbedMassSpringSystem<> mss(1);
+
+    for(auto step_rule : {GradientDescent::BB1, GradientDescent::BB2}) {
+        Vec x = GradientDescent::solve(mss.problem(), mss.x0(), 1e-7, 2000, step_rule);
+        ASSERT_NO_FATAL_FAILURE(mss.check_minimum(x, 1e-7));
+    }
+}
+
+/** Checks that the nonmonotone references are the maximum of the last values and the
+ * weighted average of all the values, never below the last one, and that the gradient
+ * descent with either reaches Newton's minimum on a mass spring system */
+TEST(GradientDescent, CheckNonmonotoneLineSearchOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    // the reference values
+    LineSearch::NonmonotoneReference f_max(3), f_average(3, LineSearch::NonmonotoneReference::AVERAGE, 0.5);
+    f_max.reset(4.);
+    f_average.reset(4.);
+    for(double f : {2., 1.5, 1.}) {
+        f_max.push(f);
+        f_average.push(f);
+    }
+    ASSERT_EQ(f_max.value(), 2.);
+    // (f_3 + 0.5 f_2 + 0.25 f_1 + 0.125 f_0) / (1 + 0.5 + 0.25 + 0.125)
+    ASSERT_NEAR(f_average.value(), (1. + 0.75 + 0.5 + 0.5) / 1.875, 1e-14);
+    f_max.push(0.5);
+    f_max.push(0.5);
+    ASSERT_EQ(f_max.value(), 1.);
+    // never below the last value
+    f_average.push(3.);
+    ASSERT_EQ(f_average.value(), 3.);
+
+    PerturbedMassSpringSystem<> mss(1);
+
+    for(auto step_rule : {GradientDescent::NONMONOTONE_MAX, GradientDescent::NONMONOTONE_AVERAGE}) {
+        Vec x = GradientDescent::solve(mss.problem(), mss.x0(), 1e-6, 100000, step_rule);
+        ASSERT_NO_FATAL_FAILURE(mss.check_minimum(x, 1e-6));
+    }
+}
+
+/** Checks that the accelerated gradient reaches Newton's minimum on the convex mass
+ * spring system (springs without length and constrained nodes) with all the restart schemes */
+TEST(AcceleratedGradient, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    PerturbedMassSpringSystem<> mss(0);
+
+    for(auto restart : {AcceleratedGradient::NO_RESTART, AcceleratedGradient::FUNCTION_RESTART,
+                        AcceleratedGradient::GRADIENT_RESTART}) {
+        Vec x = AcceleratedGradient::solve(mss.problem(), mss.x0(), 1e-7, 5000, restart);
+        ASSERT_NO_FATAL_FAILURE(mss.check_minimum(x, 1e-7));
+    }
+}
+
+/** Checks that Newton's method converges in a few iterations on a mass spring
+ * system, with a single symbolic factorization, and reaches the gradient descent's energy */
+TEST(NewtonMethod, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+    using SMat = MassSpringProblem2DSparse::SMat;
+
+    PerturbedMassSpringSystem<> mss(1);
+    auto msp = mss.problem();
+    const Vec& x0 = mss.x0();
+
+    OptimizationStatistic opt_stat(msp);
+    Vec x_newton = NewtonMethod::solve(&opt_stat, x0, 1e-8, 100);
+
+    Vec g;
+    msp->eval_gradient(x_newton, g);
+    ASSERT_LT(g.norm(), 1e-8);
+
+    Vec x_gd = GradientDescent::solve(msp, x0, 1e-6, 100000);
+    ASSERT_NEAR(msp->eval_f(x_newton), msp->eval_f(x_gd), 1e-8);
+
+    // the pattern is analyzed once, and regularization makes indefinite Hessians usable
+    SMat H;
+    msp->eval_hessian(x0, H);
+    NewtonMethod::RegularizedLDLT ldlt;
+    ASSERT_TRUE(ldlt.compute(H));
+    SMat H_indefinite = -H;
+    ASSERT_TRUE(ldlt.compute(H_indefinite));
+    ASSERT_GT(ldlt.regularization(), 0.);
+    ASSERT_TRUE(ldlt.compute(H));
+    ASSERT_EQ(ldlt.n_analyze(), 1);
+
+    Vec dx;
+    ldlt.solve(g, dx);
+    ASSERT_LE((H * dx - g).norm() - ldlt.regularization() * dx.norm(), 1e-8 * (1. + g.norm()));
+}
+
+/** Checks that the projected Newton method, i.e. Newton's method on the PSD-projected
+ * spring Hessians, solves the with-length problem from a compressed start in tens of steps */
+TEST(NewtonMethod, CheckProjectedNewtonOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    MassSpringSystemT<MassSpringProblem2DSparse> mss(8, 8, MassSpringSystemT<MassSpringProblem2DSparse>::WITH_LENGTH_PSD_HESS);
+    mss.add_constrained_spring_elements(2);
+    auto msp = mss.get_problem();
+
+    // compressed grid, where the unprojected Hessian is indefinite
+    Vec x0 = 0.5 * mss.get_spring_graph_points();
+    for(int i=0; i<x0.size(); ++i)
+        x0[i] += 0.05 * sin(3. * i);
+
+    OptimizationStatistic opt_stat(msp.get());
+    Vec x = NewtonMethod::solve(&opt_stat, x0, 1e-6, 100);
+
+    Vec g;
+    msp->eval_gradient(x, g);
+    ASSERT_LT(g.norm(), 1e-6);
+}
+
+/** Checks that the Wolfe line search returns a step satisfying both strong Wolfe conditions,
+ * with the function value and gradient at the new point, and that its cubic interpolation
+ * is exact on a quadratic function */
+TEST(LineSearch, CheckWolfeLineSearch){
+    using Vec = SpringElement2DWithLength::Vec;
+
+    SpringElement2DWithLength selw;
+    Vec coeffs(2);
+    coeffs << 1, 5;
+    ParametricFunctionWrapper<SpringElement2DWithLength> non_param_selw(selw, coeffs);
+
+    Vec x(4), g(4), dx(4), x_new, g_new;
+    x << 10, 0, -10, 0;
+    const double f_x = non_param_selw.eval_f_and_gradient(x, g);
+    dx = -g;
+
+    // too long and too short initial steps
+    for(double t0 : {1., 1e-6}) {
+        double f_new;
+        double t = LineSearch::wolfe_line_search(&non_param_selw, x, f_x, g, dx, t0, x_new, g_new, f_new);
+        ASSERT_GT(t, 0.);
+        ASSERT_NEAR((x_new - (x + t * dx)).norm(), 0, 1e-12);
+        ASSERT_NEAR(f_new, non_param_selw.eval_f(x_new), 1e-12);
+        ASSERT_LE(f_new, f_x + 1e-4 * t * g.dot(dx));
+        ASSERT_LE(std::abs(g_new.dot(dx)), -0.9 * g.dot(dx));
+
+        t = LineSearch::wolfe_line_search(&non_param_selw, x, f_x, g, dx, t0, x_new, g_new, f_new, 1e-4, 0.1);
+        ASSERT_GT(t, 0.);
+        ASSERT_LE(std::abs(g_new.dot(dx)), -0.1 * g.dot(dx));
+    }
+
+    // f(x) = 1/2 x^T A x - b^T x, whose minimum along -g from 0 is at t = g^T g / g^T A g
+    FunctionQuadraticND::Mat A(2, 2);
+    A << 3, 1, 1, 2;
+    Vec b(2);
+    b << 1, -2;
+    FunctionQuadraticND fq(A, -b, 0.);
+    Vec x2 = Vec::Zero(2), g2(2), x2_new, g2_new;
+    const double f2 = fq.eval_f(x2);
+    fq.eval_gradient(x2, g2);
+    const double t_exact = g2.squaredNorm() / g2.dot(A * g2);
+    double f2_new;
+    // a too long step and a single interpolation
+    const double t = LineSearch::wolfe_line_search(&fq, x2, f2, g2, Vec(-g2), 4. * t_exact, x2_new, g2_new, f2_new,
+                                                   1e-4, 0.1, 2);
+    ASSERT_NEAR(t, t_exact, 1e-12);
+    ASSERT_NEAR(g2_new.dot(g2), 0, 1e-12);
+}
+
+/** Checks that the Lanczos estimate bounds the largest eigenvalue of the Hessian closely,
+ * and that the gradient descent with the fixed step 1/L reaches Newton's minimum */
+TEST(GradientDescent, CheckFixedStepOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    for(int element_type : {0, 1}) {
+        PerturbedMassSpringSystem<> mss(element_type);
+        auto msp = mss.problem();
+        const Vec& x0 = mss.x0();
+
+        // the estimate is an upper bound close to the largest eigenvalue of the Hessian
+        MassSpringProblem2DSparse::SMat H;
+        msp->eval_hessian(x0, H);
+        Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(Eigen::MatrixXd(H), Eigen::EigenvaluesOnly);
+        const double lambda_max = es.eigenvalues()[x0.size() - 1];
+        const double L = LipschitzEstimator::largest_eigenvalue(msp, x0);
+        ASSERT_GE(L, lambda_max * (1. - 1e-10));
+        ASSERT_LT(L, lambda_max * 1.05);
+
+        Vec x = GradientDescent::solve(msp, x0, 1e-6, 100000, GradientDescent::FIXED_STEP);
+        ASSERT_NO_FATAL_FAILURE(mss.check_minimum(x, 1e-6));
+    }
+}
+
+/** Checks the minimization of quartic polynomials, that the line polynomial of the mass
+ * spring problems matches their energy, and the gradient descent with exact steps */
+TEST(LineSearch, CheckExactLineSearch){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    // (t - 1)^2 (t - 3)^2 + 0.1 t, whose lower minimum is close to 1
+    Vec p(5);
+    p << 9., -23.9, 22., -8., 1.;
+    const double t = LineSearch::minimize_quartic(p);
+    ASSERT_NEAR(-23.9 + 2. * 22. * t - 3. * 8. * t * t + 4. * t * t * t, 0, 1e-12);
+    ASSERT_NEAR(t, 1., 0.1);
+    // (t - 2)^2, increasing and unbounded
+    p << 4., -4., 1., 0., 0.;
+    ASSERT_NEAR(LineSearch::minimize_quartic(p), 2., 1e-12);
+    p << 1., 1., 1., 0., 0.;
+    ASSERT_EQ(LineSearch::minimize_quartic(p), 0.);
+    p << 0., -1., 0., 0., 0.;
+    ASSERT_EQ(LineSearch::minimize_quartic(p), 0.);
+
+    for(int element_type : {0, 1}) {
+        PerturbedMassSpringSystem<> mss(element_type, 2);
+        auto msp = mss.problem();
+        const Vec& x0 = mss.x0();
+
+        Vec g;
+        msp->eval_gradient(x0, g);
+
+        ASSERT_TRUE(msp->line_polynomial(x0, -g, p));
+        ASSERT_EQ(p[4] == 0., element_type == 0);
+        for(double s : {0., 0.01, 0.3, 2.}) {
+            const double f = msp->eval_f(x0 - s * g);
+            ASSERT_NEAR((((p[4] * s + p[3]) * s + p[2]) * s + p[1]) * s + p[0], f, 1e-10 * std::max(1., f));
+        }
+
+        // the exact step zeroes the slope
+        const double t_exact = LineSearch::exact_line_search(msp, x0, Vec(-g), p);
+        Vec g_new;
+        msp->eval_gradient(x0 - t_exact * g, g_new);
+        ASSERT_NEAR(g_new.dot(g) / g.squaredNorm(), 0, 1e-8);
+
+        Vec x = GradientDescent::solve(msp, x0, 1e-6, 100000, GradientDescent::EXACT);
+        msp->eval_gradient(x, g);
+        ASSERT_LT(g.norm(), 1e-6);
+    }
+}
+
+/** Checks that the concurrent evaluation of the mass-spring energy is the sequential one,
+ * and that the speculative line search, and so the gradient descent using it, takes the
+ * steps of the sequential back-tracking line search for any number of threads */
+TEST(LineSearch, CheckSpeculativeLineSearch){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    for(int element_type : {0, 1}) {
+        PerturbedMassSpringSystem<> mss(element_type, 2);
+        PerturbedMassSpringSystem<MassSpringProblem2DSparseT<SpringElement2DWithLength>> mss_static(1, 2);
+        auto msp = mss.problem();
+        const Vec& x0 = mss.x0();
+
+        // the concurrent evaluation gives the same energy as the sequential one
+        ASSERT_TRUE(msp->has_concurrent_eval_f());
+        ASSERT_EQ(msp->eval_f_concurrent(x0, 0), msp->eval_f(x0));
+        ASSERT_EQ(mss_static.problem()->eval_f_concurrent(x0, 0), mss_static.problem()->eval_f(x0));
+
+        // the first trial step satisfying Armijo is the step of the sequential backtracking
+        Vec g;
+        const double fx = msp->eval_f_and_gradient(x0, g);
+        const double t = LineSearch::backtracking_line_search(msp, x0, g, Vec(-g), 10.);
+        for(int n_threads : {1, 2, 4}) {
+            LineSearch::SpeculativeTrials trials;
+            ASSERT_EQ(LineSearch::speculative_line_search(msp, x0, fx, g, Vec(-g), 10., trials, n_threads), t);
+            ASSERT_EQ((trials.x[0] - (x0 - t * g)).norm(), 0.);
+        }
+
+        // so the gradient descent takes the same steps
+        Vec x = GradientDescent::solve(msp, x0, 1e-4, 200);
+        Vec x_speculative = GradientDescent::solve(msp, x0, 1e-4, 200, GradientDescent::BACKTRACKING, 10, 4);
+        ASSERT_EQ((x - x_speculative).norm(), 0.);
+    }
+}
+
+/** Checks that LBFGS minimizes a convex quadratic function */
+TEST(LBFGS, CheckAlgorithmOnQuadraticFunction){
+    using Vec = FunctionQuadraticND::Vec;
+
+    FunctionQuadraticND fq(10);
+    Vec x0 = Vec::Ones(10);
+
+    for(int m : {1, 5, 20}) {
+        Vec x = LBFGS::solve(&fq, x0, 1e-5, 10000, m);
+        Vec g;
+        fq.eval_gradient(x, g);
+        ASSERT_LT(g.norm(), 1e-5);
+    }
+}
+
+/** Checks that LBFGS reaches Newton's minimum on a mass spring system,
+ * and that its iterations do not allocate memory */
+TEST(LBFGS, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    PerturbedMassSpringSystem<> mss(1);
+    auto msp = mss.problem();
+    const Vec& x0 = mss.x0();
+
+    OptimizationStatistic opt_stat(msp);
+    Vec x = LBFGS::solve(&opt_stat, x0, 1e-8, 1000);
+    ASSERT_NO_FATAL_FAILURE(mss.check_minimum(x, 1e-8));
+
+    // the setup allocates the same for any number of iterations
+    long n_allocations = AllocationCounter::n_allocations();
+    LBFGS::solve(msp, x0, 1e-14, 10);
+    const long n_allocations_10 = AllocationCounter::n_allocations() - n_allocations;
+
+    n_allocations = AllocationCounter::n_allocations();
+    LBFGS::solve(msp, x0, 1e-14, 60);
+    ASSERT_EQ(AllocationCounter::n_allocations() - n_allocations, n_allocations_10);
+}
+
+/** Checks that the nonlinear CG minimizes a convex quadratic function with all the
+ * beta formulas */
+TEST(NonlinearCG, CheckAlgorithmOnQuadraticFunction){
+    using Vec = FunctionQuadraticND::Vec;
+
+    FunctionQuadraticND fq(10);
+    Vec x0 = Vec::Ones(10);
+
+    for(auto beta : {NonlinearCG::POLAK_RIBIERE_PLUS, NonlinearCG::HESTENES_STIEFEL, NonlinearCG::DAI_YUAN}) {
+        Vec x = NonlinearCG::solve(&fq, x0, 1e-5, 10000, beta);
+        Vec g;
+        fq.eval_gradient(x, g);
+        ASSERT_LT(g.norm(), 1e-5);
+    }
+}
+
+/** Checks that the nonlinear CG reaches Newton's minimum on a mass spring system */
+TEST(NonlinearCG, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    PerturbedMassSpringSystem<> mss(1);
+
+    for(bool exact_line_search : {false, true}) {
+        for(auto beta : {NonlinearCG::POLAK_RIBIERE_PLUS, NonlinearCG::HESTENES_STIEFEL, NonlinearCG::DAI_YUAN}) {
+            OptimizationStatistic opt_stat(mss.problem());
+            Vec x = NonlinearCG::solve(&opt_stat, mss.x0(), 1e-7, 10000, beta, 0, exact_line_search);
+            ASSERT_NO_FATAL_FAILURE(mss.check_minimum(x, 1e-7));
+        }
+    }
+}
+
+/** Checks that Levenberg-Marquardt on the least-squares form of a mass spring system
+ * reaches Newton's minimum in a few iterations, with a single symbolic factorization */
+TEST(LevenbergMarquardt, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DLeastSquares::Vec;
+    using SMat = MassSpringProblem2DLeastSquares::SMat;
+
+    PerturbedMassSpringSystem<MassSpringProblem2DLeastSquares> mss(1, 1, true);
+    auto msp = mss.problem();
+    const Vec& x0 = mss.x0();
+
+    Vec x = LevenbergMarquardt::solve(msp, x0, 1e-8, 100);
+    ASSERT_NO_FATAL_FAILURE(mss.check_minimum(x, 1e-8));
+
+    // J^T J + mu D is J^T J with a scaled diagonal, and its pattern is analyzed once
+    SMat J;
+    msp->eval_jacobian(x0, J);
+    LevenbergMarquardt::NormalEquations normal_equations;
+    normal_equations.update(J);
+    Vec d = Vec::Ones(x0.size()), b = Vec::LinSpaced(x0.size(), -1., 1.), dx;
+    ASSERT_TRUE(normal_equations.factorize(0.5, d));
+    normal_equations.solve(b, dx);
+    SMat JtJ = SMat(J.transpose()) * J;
+    ASSERT_LE((JtJ * dx + 0.5 * dx - b).norm(), 1e-8 * b.norm());
+    msp->eval_jacobian(x, J);
+    normal_equations.update(J);
+    ASSERT_EQ(normal_equations.n_analyze(), 1);
+}
+
+/** Checks that Newton-CG reaches Newton's minimum on a mass spring system,
+ * also from a compressed start where the Hessian is indefinite */
+TEST(NewtonCG, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    PerturbedMassSpringSystem<> mss(1);
+    auto msp = mss.problem();
+
+    OptimizationStatistic opt_stat(msp);
+    Vec x = NewtonCG::solve(&opt_stat, mss.x0(), 1e-8, 100);
+    ASSERT_NO_FATAL_FAILURE(mss.check_minimum(x, 1e-8));
+
+    Vec g;
+    Vec x1 = NewtonCG::solve(msp, 0.5 * mss.x0(), 1e-8, 200);
+    msp->eval_gradient(x1, g);
+    ASSERT_LT(g.norm(), 1e-8);
+}
+
+/** Checks that the Steihaug-CG steps stay in the trust region and follow negative
+ * curvature to its boundary, and that the trust-region method minimizes a mass spring
+ * system with springs with length from a tangled start */
+TEST(TrustRegion, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+    using SMat = MassSpringProblem2DSparse::SMat;
+
+    // indefinite diagonal model
+    SMat H(2, 2);
+    H.insert(0, 0) = 1.;
+    H.insert(1, 1) = -1.;
+    Vec g(2), p, r, d, hd;
+    g << 1., 1.;
+    int n_cg(0);
+    ASSERT_EQ(TrustRegion::steihaug_cg(H, g, 2., 1e-8, 2, p, r, d, hd, n_cg), TrustRegion::CG_NEGATIVE_CURVATURE);
+    ASSERT_NEAR(p.norm(), 2., 1e-12);
+    ASSERT_LT(g.dot(p) + 0.5 * p.dot(H * p), 0.);
+
+    // positive definite model with the minimum inside
+    H.coeffRef(1, 1) = 4.;
+    ASSERT_EQ(TrustRegion::steihaug_cg(H, g, 10., 1e-12, 2, p, r, d, hd, n_cg), TrustRegion::CG_CONVERGED);
+    ASSERT_NEAR(p[0], -1., 1e-12);
+    ASSERT_NEAR(p[1], -0.25, 1e-12);
+    ASSERT_EQ(TrustRegion::steihaug_cg(H, g, 0.5, 1e-12, 2, p, r, d, hd, n_cg), TrustRegion::CG_BOUNDARY);
+    ASSERT_NEAR(p.norm(), 0.5, 1e-12);
+
+    MassSpringSystemT<MassSpringProblem2DSparse> mss(6, 6, 1);
+    mss.add_constrained_spring_elements(1);
+    auto msp = mss.get_problem();
+
+    Vec x0 = mss.get_spring_graph_points();
+    for(int i=0; i<x0.size(); ++i)
+        x0[i] += 2. * sin(3. * i);
+
+    Vec x = TrustRegion::solve(msp.get(), x0, 1e-8, 1000);
+    msp->eval_gradient(x, g);
+    ASSERT_LT(g.norm(), 1e-8);
+    ASSERT_LT(msp->eval_f(x), msp->eval_f(x0));
+}
+
+/** Checks the multigrid's transfers and that it minimizes mass spring systems in a
+ * number of V-cycles which does not grow with the grid size */
+TEST(MassSpringMultiGrid, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+    using MultiGrid = MassSpringMultiGridT<MassSpringProblem2DSparse>;
+
+    MultiGrid mg8(8, 6, 0);
+    ASSERT_EQ(mg8.n_levels(), 2u);
+    ASSERT_EQ(mg8.n_grid_x(1), 4);
+    ASSERT_EQ(mg8.n_grid_y(1), 3);
+
+    // restrict_sum is the transpose of prolongate
+    Vec coarse(2 * 5 * 4), fine(2 * 9 * 7), p_coarse, r_fine;
+    for(int i=0; i<coarse.size(); ++i)
+        coarse[i] = sin(1.3 * i);
+    for(int i=0; i<fine.size(); ++i)
+        fine[i] = cos(0.7 * i);
+    mg8.prolongate(0, coarse, p_coarse);
+    mg8.restrict_sum(0, fine, r_fine);
+    ASSERT_NEAR(p_coarse.dot(fine), coarse.dot(r_fine), 1e-12);
+
+    // the rest positions of a grid restrict to the ones of the coarse grid
+    MassSpringSystemT<MassSpringProblem2DSparse> mss8(8, 6, 0);
+    Vec x_coarse;
+    mg8.restrict_positions(0, mss8.get_spring_graph_points(), x_coarse);
+    ASSERT_NEAR((x_coarse - mg8.get_system(1)->get_spring_graph_points()).norm(), 0, 1e-12);
+
+    for(int element_type : {0, 1}) {
+        int n_cycles_16(0);
+        for(int n_grid : {16, 32}) {
+            MassSpringSystemT<MassSpringProblem2DSparse> mss(n_grid, n_grid, element_type);
+            mss.add_constrained_spring_elements(1);
+            auto msp = mss.get_problem();
+
+            Vec x0 = mss.get_spring_graph_points();
+            for(int i=0; i<x0.size(); ++i)
+                x0[i] += 0.1 * sin(3. * i);
+
+            MultiGrid mg(n_grid, n_grid, element_type, 1);
+            ASSERT_EQ(mg.n_levels(), n_grid == 16 ? 4u : 5u);
+            Vec x = mg.solve(msp.get(), x0, 1e-6, 30);
+
+            Vec g;
+            msp->eval_gradient(x, g);
+            ASSERT_LT(g.norm(), 1e-6);
+
+            // at most a couple more V-cycles on the grid with 4 times as many nodes
+            if(n_grid == 16)
+                n_cycles_16 = mg.n_cycles();
+            else
+                ASSERT_LE(mg.n_cycles(), n_cycles_16 + 2);
+        }
+    }
+}
+
+/** Checks the partition and the sub-problems of the overlapping Schwarz method, which
+ * must have the full gradient at their free nodes, and that both variants minimize a
+ * mass spring system, with the same result on any number of threads */
+TEST(OverlappingSchwarz, CheckAlgorithmOnMassSpringSystem){
+    using Vec = MassSpringProblem2DSparse::Vec;
+
+    for(int element_type : {0, 1}) {
+        MassSpringSystemT<MassSpringProblem2DSparse> mss(12, 12, element_type);
+        mss.add_constrained_spring_elements(1);
+        auto msp = mss.get_problem();
+
+        OverlappingSchwarz schwarz(*msp, mss.get_spring_graph_points(), 4, 2);
+        ASSERT_EQ(schwarz.n_subdomains(), 4);
+        ASSERT_GT(schwarz.n_colors(), 1);
+
+        Vec x0 = mss.get_spring_graph_points();
+        for(int i=0; i<x0.size(); ++i)
+            x0[i] += 0.2 * sin(3. * i);
+        Vec g;
+        msp->eval_gradient(x0, g);
+
+        std::vector<int> part_sizes(4, 0);
+        for(int s : schwarz.partition())
+            ++part_sizes[s];
+        for(int s = 0; s < 4; ++s) {
+            ASSERT_GE(part_sizes[s], 169 / 4);
+            ASSERT_LE(part_sizes[s], 169 / 4 + 1);
+
+            const auto& nodes = schwarz.subdomain_nodes(s);
+            const int n_free = schwarz.n_free_nodes(s);
+            ASSERT_LT(n_free, int(nodes.size()));
+            std::vector<int> local_index(169, -1);
+            Vec x_local(2 * nodes.size());
+            for(size_t k = 0; k < nodes.size(); ++k) {
+                local_index[nodes[k]] = k;
+                x_local.segment(2 * k, 2) = x0.segment(2 * nodes[k], 2);
+            }
+            for(int k = 0; k < part_sizes[s]; ++k)
+                ASSERT_EQ(schwarz.partition()[nodes[k]], s);
+
+            Vec g_local;
+            msp->make_subproblem(local_index, nodes.size())->eval_gradient(x_local, g_local);
+            for(int k = 0; k < n_free; ++k)
+                ASSERT_NEAR((g_local.segment(2 * k, 2) - g.segment(2 * nodes[k], 2)).norm(), 0, 1e-10);
+        }
+
+        for(auto variant : {OverlappingSchwarz::MULTIPLICATIVE, OverlappingSchwarz::ADDITIVE}) {
+            Vec x = schwarz.solve(msp.get(), x0, 1e-6, 500, variant);
+            msp->eval_gradient(x, g);
+            ASSERT_LT(g.norm(), 1e-6);
+
+            schwarz.set_n_threads(2);
+            Vec x2 = schwarz.solve(msp.get(), x0, 1e-6, 500, variant);
+            schwarz.set_n_threads(1);
+            ASSERT_EQ((x2 - x).norm(), 0.);
+        }
+    }
+}
+
 int main(int _argc, char** _argv){
 
     testing::InitGoogleTest(&_argc, _argv);
@@ -11,15 +11,15 @@ using namespace AOPT;
 int main(int _argc, const char* _argv[]) {
     if(_argc < 5) {
         std::cout << "Usage: input should be 'function index(0: f without length, 1: f with length), "
-                     "sparse hessian (0: dense, 1: sparse), number of grids in x, number of grids in y, filename (optional)', e.g. "
+                     "hessian type (0: dense, 1: sparse, 2: banded), number of grids in x, number of grids in y, filename (optional)', e.g. "
                      "./MassSpringProblemEvaluation 1 1 10 10 /usr/spring" << std::endl;
         return -1;
     }
 
     //read the input parameters
-    int func_index, sparse, n_grid_x, n_grid_y;
+    int func_index, hessian_type, n_grid_x, n_grid_y;
     func_index = atoi(_argv[1]);
-    sparse = atoi(_argv[2]);
+    hessian_type = atoi(_argv[2]);
     n_grid_x = atoi(_argv[3]);
     n_grid_y = atoi(_argv[4]);
 
@@ -38,7 +38,7 @@ int main(int _argc, const char* _argv[]) {
     AOPT::StopWatch<> sw;
 
     //initial energy
-    if(!sparse) {
+    if(hessian_type == 0) {
         AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DDense> mss(n_grid_x, n_grid_y, func_index);
         //set coordinates for graph nodes
         mss.set_spring_graph_points(points);
@@ -59,6 +59,26 @@ int main(int _argc, const char* _argv[]) {
         std::cout<<"MassSpring system hessian norm is "<<h.norm()<<std::endl;
 
         std::cout<<"Evaluating on DENSE hessian takes: "<<sw.stop()/1000.<<"s"<< std::endl;
+    } else if(hessian_type == 2) {
+        AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DDense> mss(n_grid_x, n_grid_y, func_index);
+        mss.set_spring_graph_points(points);
+
+        std::cout<<"Evaluating the Banded MassSpringSystem..."<<std::endl;
+        auto energy = mss.initial_system_energy();
+        std::cout<<"MassSpring system energy is "<<energy<<std::endl;
+
+        int n_unknowns = mss.get_problem()->n_unknowns();
+        FunctionBase::Vec gradient(n_unknowns);
+        mss.get_problem()->eval_gradient(points, gradient);
+        std::cout<<"MassSpring system gradient norm is "<<gradient.norm()<<std::endl;
+
+        sw.start();
+
+        AOPT::BandedSymmetricMatrix bh;
+        mss.get_problem()->eval_hessian(points, bh);
+        std::cout<<"MassSpring system hessian norm is "<<bh.norm()<<" (bandwidth "<<bh.bandwidth()<<")"<<std::endl;
+
+        std::cout<<"Evaluating on BANDED hessian takes: "<<sw.stop()/1000.<<"s"<< std::endl;
     } else {
         AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DSparse> mss(n_grid_x, n_grid_y, func_index);
         mss.set_spring_graph_points(points);
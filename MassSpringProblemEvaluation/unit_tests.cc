@@ -107,6 +107,77 @@ TEST(SpringElements, SpringElement2DWithLengthFunctions){
 
 
 
+/** Checks that the projected Hessian of SpringElement2DWithLengthPSDHessian is the
+ * eigenvalue-clamped Hessian of SpringElement2DWithLength, for stretched and compressed springs */
+TEST(SpringElements, SpringElement2DWithLengthPSDHessian){
+    using Vec = SpringElement2DWithLength::Vec;
+    using Mat = SpringElement2DWithLength::Mat;
+
+    SpringElement2DWithLength sewl;
+    SpringElement2DWithLengthPSDHessian sewl_psd;
+
+    Vec coeffs(2);
+    coeffs << 3., 1.5;
+
+    Mat H(4, 4), H_psd(4, 4);
+    SpringElement2DWithLengthPSDHessian::Mat4 H_static;
+    for(double scale : {0., 0.3, 0.7, 1., 2.}) {
+        Vec x(4);
+        x << scale * 0.6, scale * 0.8, 0., 0.;
+
+        // same energy and gradient
+        Vec g(4), g_psd(4);
+        ASSERT_EQ(sewl.eval_f(x, coeffs), sewl_psd.eval_f(x, coeffs));
+        sewl.eval_gradient(x, coeffs, g);
+        sewl_psd.eval_gradient(x, coeffs, g_psd);
+        ASSERT_EQ(g, g_psd);
+
+        sewl.eval_hessian(x, coeffs, H);
+        sewl_psd.eval_hessian(x, coeffs, H_psd);
+
+        Eigen::SelfAdjointEigenSolver<Mat> es(H);
+        Mat H_clamped = es.eigenvectors() * es.eigenvalues().cwiseMax(0.).asDiagonal() * es.eigenvectors().transpose();
+        ASSERT_LE((H_psd - H_clamped).norm(), 1e-12 * (1. + H.norm()));
+        ASSERT_GE(Eigen::SelfAdjointEigenSolver<Mat>(H_psd).eigenvalues().minCoeff(), -1e-12 * (1. + H.norm()));
+
+        SpringElement2DWithLengthPSDHessian::hessian(x, coeffs[0], coeffs[1], H_static);
+        ASSERT_LE((H_static - H_psd).norm(), 1e-12 * (1. + H.norm()));
+    }
+}
+
+
+
+/** checks that the residual forms of the elements give their energy as 1/2 ||r||^2
+ * and their gradient as J^T r */
+TEST(SpringElements, ResidualForms){
+    using Vec = ParametricFunctionBase::Vec;
+    using Mat = ParametricFunctionBase::Mat;
+
+    SpringElement2D se;
+    SpringElement2DWithLength sewl;
+    ConstrainedSpringElement2D cse;
+
+    Vec x4(4), x2(2), c2(2), c3(3);
+    x4 << 0.3, -1.2, 2.1, 0.4;
+    x2 << 0.3, -1.2;
+    c2 << 3., 1.5;
+    c3 << 5., 1., 2.;
+
+    auto check = [](ParametricFunctionBase& _f, ParametricResidualBase& _res, const Vec& _x, const Vec& _c) {
+        Vec r(_res.n_residuals()), g(_f.n_unknowns());
+        Mat J(_res.n_residuals(), _f.n_unknowns());
+        _res.eval_residual(_x, _c, r);
+        _res.eval_jacobian(_x, _c, J);
+        _f.eval_gradient(_x, _c, g);
+        ASSERT_NEAR(0.5 * r.squaredNorm(), _f.eval_f(_x, _c), 1e-12);
+        ASSERT_LE((J.transpose() * r - g).norm(), 1e-12);
+    };
+    check(se, se, x4, c2);
+    check(sewl, sewl, x4, c2);
+    check(cse, cse, x2, c3);
+}
+
+
 /** Compares your MSP Dense's functions (energy, gradient and Hessian)
  * results with the manually computed ones */
 TEST(MassSpringProblem, MassSpringProblem2DDenseFunctions){
@@ -218,6 +289,523 @@ TEST(MassSpringProblem, MassSpringProblem2DSparseCheckDerivative){
 
 
 
+/** Checks that the single pass eval_f_and_gradient gives the same results
+ * as separately calling eval_f and eval_gradient */
+TEST(MassSpringProblem, FusedFunctionAndGradient){
+    typedef MassSpringProblem2DSparse::Vec Vec;
+
+    int n_grid_x(6), n_grid_y(4);
+    const int n_vertices = (n_grid_x+1)*(n_grid_y+1);
+
+    Vec points(2*n_vertices);
+    for(int i=0; i<n_vertices; ++i) {
+        points[2*i] = sin(i * 0.3);
+        points[2*i+1] = sin(i * 0.1);
+    }
+
+    for(int func_index = 0; func_index <= 1; ++func_index) {
+        AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DSparse> mss(n_grid_x, n_grid_y, func_index);
+        auto msp = mss.get_problem();
+        msp->add_constrained_spring_element(0, 10., -1., 2.);
+        msp->add_constrained_spring_element(n_vertices - 1, 5., 3., 1.);
+
+        Vec g, g_fused;
+        double f = msp->eval_f(points);
+        msp->eval_gradient(points, g);
+        double f_fused = msp->eval_f_and_gradient(points, g_fused);
+
+        ASSERT_DOUBLE_EQ(f, f_fused);
+        ASSERT_LT((g - g_fused).norm(), 1e-12 * (1. + g.norm()));
+
+        AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DDense> mss_dense(n_grid_x, n_grid_y, func_index);
+        f = mss_dense.get_problem()->eval_f(points);
+        mss_dense.get_problem()->eval_gradient(points, g);
+        f_fused = mss_dense.get_problem()->eval_f_and_gradient(points, g_fused);
+
+        ASSERT_DOUBLE_EQ(f, f_fused);
+        ASSERT_LT((g - g_fused).norm(), 1e-12 * (1. + g.norm()));
+    }
+}
+
+
+
+/** Checks that the cached Hessian pattern is reused between evaluations and
+ * rebuilt when the topology changes */
+TEST(MassSpringProblem, MassSpringProblem2DSparseCachedHessianPattern){
+    typedef MassSpringProblem2DSparse::Vec Vec;
+    typedef MassSpringProblem2DSparse::Mat Mat;
+    typedef MassSpringProblem2DSparse::SMat SMat;
+
+    int n_unknowns(8);
+
+    SpringElement2DWithLength sewl;
+    MassSpringProblem2DSparse msp(sewl, n_unknowns);
+    MassSpringProblem2DDense msp_dense(sewl, n_unknowns);
+
+    Vec x(n_unknowns);
+    for(int i(0); i<n_unknowns/2; i++){
+        x[2*i] = i;
+        x[2*i+1] = -i+1;
+        msp.add_spring_element(i, (i+1)%(n_unknowns/2));
+        msp_dense.add_spring_element(i, (i+1)%(n_unknowns/2));
+    }
+
+    SMat H;
+    Mat H_dense;
+    msp.eval_hessian(x, H);
+    msp_dense.eval_hessian(x, H_dense);
+    ASSERT_EQ(Mat(H), H_dense);
+
+    // second evaluation refills the same storage
+    const double* values = H.valuePtr();
+    x *= 0.5;
+    msp.eval_hessian(x, H);
+    msp_dense.eval_hessian(x, H_dense);
+    ASSERT_EQ(H.valuePtr(), values);
+    ASSERT_EQ(Mat(H), H_dense);
+
+    // new springs change the pattern
+    msp.add_spring_element(0, 2, 2., 0.5);
+    msp_dense.add_spring_element(0, 2, 2., 0.5);
+    msp.eval_hessian(x, H);
+    msp_dense.eval_hessian(x, H_dense);
+    ASSERT_EQ(Mat(H), H_dense);
+
+    // constrained nodes only add to the diagonal
+    msp.add_constrained_spring_element(3, 7.);
+    msp.eval_hessian(x, H);
+    H_dense(6, 6) += 7.;
+    H_dense(7, 7) += 7.;
+    ASSERT_EQ(Mat(H), H_dense);
+}
+
+
+
+/** Checks that the statically-dispatched MSP gives the same results as the
+ * runtime polymorphic one, for both spring element types */
+template<class Element>
+void check_static_mass_spring_problem(const int _func_index) {
+    typedef MassSpringProblem2DSparse::Vec Vec;
+    typedef MassSpringProblem2DSparse::SMat SMat;
+
+    int n_grid_x(6), n_grid_y(4);
+    const int n_vertices = (n_grid_x+1)*(n_grid_y+1);
+
+    Vec points(2*n_vertices);
+    for(int i=0; i<n_vertices; ++i) {
+        points[2*i] = sin(i * 0.3);
+        points[2*i+1] = sin(i * 0.1);
+    }
+
+    AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DSparse> mss(n_grid_x, n_grid_y, _func_index);
+    AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DSparseT<Element>> mss_static(n_grid_x, n_grid_y, _func_index);
+    auto msp = mss.get_problem();
+    auto msp_static = mss_static.get_problem();
+    msp->add_constrained_spring_element(0, 10., -1., 2.);
+    msp_static->add_constrained_spring_element(0, 10., -1., 2.);
+
+    ASSERT_NEAR(msp->eval_f(points), msp_static->eval_f(points), 1e-10);
+
+    Vec g, g_static;
+    msp->eval_gradient(points, g);
+    msp_static->eval_gradient(points, g_static);
+    ASSERT_LT((g - g_static).norm(), 1e-10);
+
+    SMat H, H_static;
+    msp->eval_hessian(points, H);
+    msp_static->eval_hessian(points, H_static);
+    ASSERT_LT((H - H_static).norm(), 1e-10);
+}
+
+TEST(MassSpringProblem, MassSpringProblem2DSparseStaticDispatch){
+    check_static_mass_spring_problem<SpringElement2D>(0);
+    check_static_mass_spring_problem<SpringElement2DWithLength>(1);
+}
+
+
+
+/** Checks that the SIMD spring kernels match the scalar path within 1e-12 relative,
+ * for each instruction set supported by the CPU */
+template<class Element>
+void check_simd_mass_spring_problem(const int _func_index) {
+    typedef MassSpringProblem2DSparse::Vec Vec;
+
+    // 7x5 grid -> 159 springs, which is not a multiple of the SIMD widths
+    int n_grid_x(7), n_grid_y(5);
+    const int n_vertices = (n_grid_x+1)*(n_grid_y+1);
+
+    Vec points(2*n_vertices);
+    for(int i=0; i<n_vertices; ++i) {
+        points[2*i] = sin(i * 0.3);
+        points[2*i+1] = sin(i * 0.1);
+    }
+
+    AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DSparseT<Element>> mss(n_grid_x, n_grid_y, _func_index);
+    auto msp = mss.get_problem();
+
+    msp->set_simd_isa(SpringKernelsSIMD::SCALAR);
+    Vec g_scalar;
+    double f_scalar = msp->eval_f(points);
+    double fg_scalar = msp->eval_f_and_gradient(points, g_scalar);
+
+    for(int isa = SpringKernelsSIMD::AVX2; isa <= SpringKernelsSIMD::detected_isa(); ++isa) {
+        msp->set_simd_isa(SpringKernelsSIMD::Isa(isa));
+        ASSERT_EQ(msp->simd_isa(), isa);
+
+        Vec g;
+        double f = msp->eval_f(points);
+        double fg = msp->eval_f_and_gradient(points, g);
+
+        ASSERT_LE(std::abs(f - f_scalar), 1e-12 * std::abs(f_scalar));
+        ASSERT_LE(std::abs(fg - fg_scalar), 1e-12 * std::abs(fg_scalar));
+        ASSERT_LE((g - g_scalar).norm(), 1e-12 * g_scalar.norm());
+    }
+}
+
+TEST(MassSpringProblem, MassSpringProblem2DSparseSIMDKernels){
+    check_simd_mass_spring_problem<SpringElement2D>(0);
+    check_simd_mass_spring_problem<SpringElement2DWithLength>(1);
+}
+
+
+
+/** Checks that the spring coloring is valid, i.e. that no two springs of a color
+ * share a node, and that the multithreaded gradient and Hessian match the serial ones */
+TEST(MassSpringProblem, MassSpringProblem2DSparseColoredAssembly){
+    typedef MassSpringProblem2DSparse::Vec Vec;
+    typedef MassSpringProblem2DSparse::SMat SMat;
+
+    // grid with both diagonals, i.e. up to 8 springs per node
+    int n_grid_x(9), n_grid_y(7);
+    const int n_vertices = (n_grid_x+1)*(n_grid_y+1);
+    auto index = [&](int _i, int _j) { return _i * (n_grid_y+1) + _j; };
+
+    std::vector<std::pair<int, int>> springs;
+    for(int i=0; i<=n_grid_x; ++i)
+        for(int j=0; j<=n_grid_y; ++j) {
+            if(i < n_grid_x) springs.emplace_back(index(i, j), index(i+1, j));
+            if(j < n_grid_y) springs.emplace_back(index(i, j), index(i, j+1));
+            if(i < n_grid_x && j < n_grid_y) {
+                springs.emplace_back(index(i, j), index(i+1, j+1));
+                springs.emplace_back(index(i+1, j), index(i, j+1));
+            }
+        }
+
+    SpringElement2DWithLength sewl;
+    MassSpringProblem2DSparse msp(sewl, 2*n_vertices);
+    MassSpringProblem2DSparseT<SpringElement2DWithLength> msp_static(sewl, 2*n_vertices);
+    for(auto& s : springs) {
+        msp.add_spring_element(s.first, s.second, 2., 0.5);
+        msp_static.add_spring_element(s.first, s.second, 2., 0.5);
+    }
+    // constrain a node twice so that the constrained nodes need two colors as well
+    msp.add_constrained_spring_element(0, 10., -1., 2.);
+    msp.add_constrained_spring_element(0, 5., 1., 1.);
+    msp_static.add_constrained_spring_element(0, 10., -1., 2.);
+    msp_static.add_constrained_spring_element(0, 5., 1., 1.);
+
+    // springs of the same color are node-disjoint
+    auto& colors = msp.spring_colors();
+    const int n_colors = msp.n_spring_colors();
+    ASSERT_EQ(colors.size(), springs.size());
+    ASSERT_GE(n_colors, 8);
+    for(int c = 0; c < n_colors; ++c) {
+        std::vector<bool> touched(n_vertices, false);
+        for(size_t i = 0; i < springs.size(); ++i) {
+            if(colors[i] != c)
+                continue;
+            ASSERT_FALSE(touched[springs[i].first]);
+            ASSERT_FALSE(touched[springs[i].second]);
+            touched[springs[i].first] = true;
+            touched[springs[i].second] = true;
+        }
+    }
+
+    Vec points(2*n_vertices);
+    for(int i=0; i<n_vertices; ++i) {
+        points[2*i] = sin(i * 0.3);
+        points[2*i+1] = sin(i * 0.1);
+    }
+
+    Vec g_serial, g_static_serial;
+    double f_serial = msp.eval_f_and_gradient(points, g_serial);
+    double f_static_serial = msp_static.eval_f_and_gradient(points, g_static_serial);
+    SMat H_serial, H_static_serial;
+    msp.eval_hessian(points, H_serial);
+    msp_static.eval_hessian(points, H_static_serial);
+
+    msp.set_n_threads(4);
+    msp_static.set_n_threads(4);
+    ASSERT_EQ(msp.n_threads(), 4);
+
+    Vec g, g_fused, g_static;
+    msp.eval_gradient(points, g);
+    double f = msp.eval_f_and_gradient(points, g_fused);
+    double f_static = msp_static.eval_f_and_gradient(points, g_static);
+
+    ASSERT_LE((g - g_serial).norm(), 1e-12 * g_serial.norm());
+    ASSERT_LE((g_fused - g_serial).norm(), 1e-12 * g_serial.norm());
+    ASSERT_LE((g_static - g_static_serial).norm(), 1e-12 * g_static_serial.norm());
+    ASSERT_LE(std::abs(f - f_serial), 1e-12 * std::abs(f_serial));
+    ASSERT_LE(std::abs(f_static - f_static_serial), 1e-12 * std::abs(f_static_serial));
+
+    SMat H, H_static;
+    msp.eval_hessian(points, H);
+    msp_static.eval_hessian(points, H_static);
+    ASSERT_LE((H - H_serial).norm(), 1e-12 * H_serial.norm());
+    ASSERT_LE((H_static - H_static_serial).norm(), 1e-12 * H_static_serial.norm());
+}
+
+
+
+/** Checks that the energy of a problem with several chunks of springs is bitwise
+ * identical for any number of threads, see ReproducibleSum */
+TEST(MassSpringProblem, ReproducibleParallelEnergy){
+    typedef MassSpringProblem2DSparse::Vec Vec;
+
+    // 30x30 grid with both diagonals -> 3540 springs, i.e. 4 chunks
+    int n_grid(30);
+    const int n_vertices = (n_grid+1)*(n_grid+1);
+    auto index = [&](int _i, int _j) { return _i * (n_grid+1) + _j; };
+
+    SpringElement2DWithLength sewl;
+    MassSpringProblem2DSparse msp(sewl, 2*n_vertices);
+    MassSpringProblem2DSparseT<SpringElement2DWithLength> msp_static(sewl, 2*n_vertices);
+    MassSpringProblem2DDense msp_dense(sewl, 2*n_vertices);
+    Vec points(2*n_vertices);
+    for(int i=0; i<n_vertices; ++i) {
+        points[2*i] = sin(i * 0.3);
+        points[2*i+1] = sin(i * 0.1);
+    }
+
+    for(int i=0; i<=n_grid; ++i)
+        for(int j=0; j<=n_grid; ++j) {
+            std::vector<int> ends;
+            if(i < n_grid) ends.push_back(index(i+1, j));
+            if(j < n_grid) ends.push_back(index(i, j+1));
+            if(i < n_grid && j < n_grid) ends.push_back(index(i+1, j+1));
+            for(int e : ends) {
+                msp.add_spring_element(index(i, j), e, 1.5, 0.7);
+                msp_static.add_spring_element(index(i, j), e, 1.5, 0.7);
+                msp_dense.add_spring_element(index(i, j), e, 1.5, 0.7);
+            }
+            if(i < n_grid && j < n_grid) {
+                msp.add_spring_element(index(i+1, j), index(i, j+1), 1.5, 0.7);
+                msp_static.add_spring_element(index(i+1, j), index(i, j+1), 1.5, 0.7);
+                msp_dense.add_spring_element(index(i+1, j), index(i, j+1), 1.5, 0.7);
+            }
+        }
+    for(int i=0; i<n_vertices; i+=10) {
+        msp.add_constrained_spring_element(i, 3., 0.5, -0.5);
+        msp_static.add_constrained_spring_element(i, 3., 0.5, -0.5);
+    }
+
+    // the dense problem has no constrained nodes
+    double cs_energy(0);
+    for(int i=0; i<n_vertices; i+=10) {
+        const double dx = points[2*i] - 0.5, dy = points[2*i+1] + 0.5;
+        cs_energy += 0.5 * 3. * (dx*dx + dy*dy);
+    }
+    const double f_serial = msp.eval_f(points);
+    const double f_static_serial = msp_static.eval_f(points);
+    const double f_dense_serial = msp_dense.eval_f(points);
+    ASSERT_NEAR(f_serial, f_dense_serial + cs_energy, 1e-10 * f_serial);
+    ASSERT_NEAR(f_serial, f_static_serial, 1e-10 * f_serial);
+
+    Vec g;
+    ASSERT_EQ(msp.eval_f_and_gradient(points, g), f_serial);
+    ASSERT_EQ(msp_static.eval_f_and_gradient(points, g), f_static_serial);
+    ASSERT_EQ(msp_dense.eval_f_and_gradient(points, g), f_dense_serial);
+
+    for(int n_threads : {2, 3, 4, 7}) {
+        msp.set_n_threads(n_threads);
+        msp_static.set_n_threads(n_threads);
+        msp_dense.set_n_threads(n_threads);
+
+        ASSERT_EQ(msp.eval_f(points), f_serial);
+        ASSERT_EQ(msp.eval_f_and_gradient(points, g), f_serial);
+        ASSERT_EQ(msp_static.eval_f(points), f_static_serial);
+        ASSERT_EQ(msp_static.eval_f_and_gradient(points, g), f_static_serial);
+        ASSERT_EQ(msp_dense.eval_f(points), f_dense_serial);
+    }
+}
+
+
+
+/** Checks the banded Hessian of the dense MSP against the dense one, as well as
+ * the banded Cholesky solve */
+TEST(MassSpringProblem, MassSpringProblem2DDenseBandedHessian){
+    typedef MassSpringProblem2DDense::Vec Vec;
+    typedef MassSpringProblem2DDense::Mat Mat;
+
+    int n_grid_x(5), n_grid_y(4);
+    const int n_vertices = (n_grid_x+1)*(n_grid_y+1);
+
+    Vec points(2*n_vertices);
+    for(int i=0; i<n_vertices; ++i) {
+        points[2*i] = sin(i * 0.3);
+        points[2*i+1] = sin(i * 0.1);
+    }
+
+    AOPT::MassSpringSystemT<AOPT::MassSpringProblem2DDense> mss(n_grid_x, n_grid_y, 1);
+    auto msp = mss.get_problem();
+    ASSERT_EQ(msp->hessian_bandwidth(), 2*(n_grid_x+2)+1);
+
+    Mat H;
+    BandedSymmetricMatrix H_banded;
+    msp->eval_hessian(points, H);
+    msp->eval_hessian(points, H_banded);
+    ASSERT_EQ(H_banded.rows(), H.rows());
+    ASSERT_LE((H_banded.to_dense() - H).norm(), 1e-12 * H.norm());
+    ASSERT_NEAR(H_banded.norm(), H.norm(), 1e-12 * H.norm());
+
+    Vec y, y_dense = H * points;
+    H_banded.multiply(points, y);
+    ASSERT_LE((y - y_dense).norm(), 1e-12 * y_dense.norm());
+
+    // shift the spectrum to get a positive definite matrix
+    const double shift = 1. - Eigen::SelfAdjointEigenSolver<Mat>(H).eigenvalues().minCoeff();
+    for(int i=0; i<H.rows(); ++i) {
+        H(i, i) += shift;
+        H_banded.lower(i, i) += shift;
+    }
+
+    BandedCholesky chol;
+    ASSERT_TRUE(chol.compute(H_banded));
+    Vec x;
+    chol.solve(points, x);
+    ASSERT_LE((H * x - points).norm(), 1e-10 * points.norm());
+    ASSERT_LE((x - H.llt().solve(points)).norm(), 1e-10 * x.norm());
+
+    // not positive definite
+    H_banded.lower(0, 0) = -1.;
+    ASSERT_FALSE(chol.compute(H_banded));
+}
+
+
+
+/** Spring element without residual form, used by one of the tests */
+class SpringElementWithoutResidual final : public ParametricFunctionBase {
+public:
+    virtual int n_unknowns() override { return se_.n_unknowns(); }
+
+    virtual double eval_f(const Vec &_x, const Vec &_coeffs) override {
+        return se_.eval_f(_x, _coeffs);
+    }
+
+    virtual void eval_gradient(const Vec &_x, const Vec &_coeffs, Vec &_g) override {
+        se_.eval_gradient(_x, _coeffs, _g);
+    }
+
+    virtual void eval_hessian(const Vec &_x, const Vec &_coeffs, Mat &_H) override {
+        se_.eval_hessian(_x, _coeffs, _H);
+    }
+
+private:
+    SpringElement2D se_;
+};
+
+/** Checks the least-squares form of the sparse MSP: its residuals give the energy,
+ * J^T r the gradient, J matches finite differences, and the cached Jacobian pattern
+ * is refilled in place and rebuilt when springs are added. A spring element without
+ * residual form is rejected */
+TEST(MassSpringProblem, MassSpringProblem2DLeastSquares){
+    using Vec = MassSpringProblem2DLeastSquares::Vec;
+    using SMat = MassSpringProblem2DLeastSquares::SMat;
+
+    for(int type : {0, 1}) {
+        MassSpringSystemT<MassSpringProblem2DSparse> mss(3, 4, type, true);
+        mss.add_constrained_spring_elements(2);
+        auto msp = std::dynamic_pointer_cast<MassSpringProblem2DLeastSquares>(mss.get_problem());
+        ASSERT_NE(msp, nullptr);
+        msp->add_constrained_spring_element(0, 10., -1., 0.5);
+
+        Vec x = mss.get_spring_graph_points();
+        for(int i=0; i<x.size(); ++i)
+            x[i] += 0.3 * sin(2. * i);
+
+        Vec r, g;
+        SMat J;
+        msp->eval_residual(x, r);
+        msp->eval_jacobian(x, J);
+        msp->eval_gradient(x, g);
+        ASSERT_EQ(r.size(), msp->n_residuals());
+        ASSERT_NEAR(0.5 * r.squaredNorm(), msp->eval_f(x), 1e-10);
+        ASSERT_LE((J.transpose() * r - g).norm(), 1e-10 * (1. + g.norm()));
+
+        const double h = 1e-6;
+        Vec r_p, r_m;
+        for(int j=0; j<x.size(); ++j) {
+            Vec xp = x, xm = x;
+            xp[j] += h;
+            xm[j] -= h;
+            msp->eval_residual(xp, r_p);
+            msp->eval_residual(xm, r_m);
+            ASSERT_LE(((r_p - r_m) / (2. * h) - Vec(J.col(j))).norm(), 1e-6);
+        }
+
+        const double* values = J.valuePtr();
+        msp->eval_jacobian(x, J);
+        ASSERT_EQ(values, J.valuePtr());
+
+        msp->add_spring_element(0, 5, 1., 1.);
+        msp->eval_residual(x, r);
+        msp->eval_jacobian(x, J);
+        msp->eval_gradient(x, g);
+        ASSERT_EQ(J.rows(), r.size());
+        ASSERT_LE((J.transpose() * r - g).norm(), 1e-10 * (1. + g.norm()));
+    }
+
+    SpringElementWithoutResidual sewr;
+    ASSERT_THROW(MassSpringProblem2DLeastSquares(sewr, 8), std::invalid_argument);
+}
+
+/** Checks that the matrix-free Hessian-vector products of the sparse MSPs match the
+ * product with the assembled Hessian, as does the default of FunctionBaseSparse */
+TEST(MassSpringProblem, MassSpringProblem2DSparseHessianVector){
+    using Vec = MassSpringProblem2DSparse::Vec;
+    using SMat = MassSpringProblem2DSparse::SMat;
+
+    for(int type : {0, 1}) {
+        MassSpringSystemT<MassSpringProblem2DSparse> mss(5, 4, type);
+        mss.add_constrained_spring_elements(2);
+        auto msp = mss.get_problem();
+        msp->add_constrained_spring_element(3, 10., -1., 0.5);
+
+        Vec x = mss.get_spring_graph_points();
+        Vec v(x.size());
+        for(int i=0; i<x.size(); ++i) {
+            x[i] += 0.3 * sin(2. * i);
+            v[i] = cos(i);
+        }
+
+        SMat H;
+        msp->eval_hessian(x, H);
+        Vec hv, hv_default;
+        msp->eval_hessian_vector(x, v, hv);
+        msp->FunctionBaseSparse::eval_hessian_vector(x, v, hv_default);
+        ASSERT_LE((hv - H * v).norm(), 1e-10 * (1. + hv.norm()));
+        ASSERT_LE((hv_default - H * v).norm(), 1e-10 * (1. + hv.norm()));
+    }
+
+    // statically dispatched kernels
+    SpringElement2DWithLength sewl;
+    MassSpringProblem2DSparse msp(sewl, 8);
+    MassSpringProblem2DSparseT<SpringElement2DWithLength> msp_t(sewl, 8);
+    for(auto p : {(MassSpringProblem2DSparse*)&msp, (MassSpringProblem2DSparse*)&msp_t}) {
+        p->add_spring_element(0, 1, 2., 1.);
+        p->add_spring_element(1, 2, 1., 0.5);
+        p->add_spring_element(2, 3, 3., 2.);
+        p->add_constrained_spring_element(0, 5., 0., 0.);
+    }
+    Vec x(8), v(8), hv, hv_t;
+    x << 0., 0.1, 1.2, -0.3, 2., 0.5, 0.4, 1.;
+    v << 1., -2., 0.5, 3., -1., 0., 2., 1.;
+    msp.eval_hessian_vector(x, v, hv);
+    msp_t.eval_hessian_vector(x, v, hv_t);
+    ASSERT_LE((hv - hv_t).norm(), 1e-12 * (1. + hv.norm()));
+}
+
 /** Compares your MSS's energy computation's results with ours */
 TEST(MassSpringSystem, EnergyComputation){
     int n_grid_x(20), n_grid_y(20);
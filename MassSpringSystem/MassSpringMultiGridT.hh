@@ -0,0 +1,362 @@
+#pragma once
+
+#include "MassSpringSystemT.hh"
+
+#include <FunctionBase/FunctionBaseSparse.hh>
+#include <Algorithms/LineSearch.hh>
+#include <Algorithms/NewtonMethod.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+//== CLASS DEFINITION =========================================================
+
+    /* Nonlinear geometric multigrid (MG/OPT) for the mass spring systems built on the
+     * regular grids of MassSpringSystemT.
+     *
+     * The coarse levels are MassSpringSystemT's with n_grid_x and n_grid_y halved as long
+     * as they stay even and at least _n_coarsest, with the same spring element type and
+     * constrained scenario. The coarse node (I, J) is the fine node (2I, 2J), and since a
+     * coarse grid has unit spacing as the fine one, coarse positions are fine positions / 2.
+     * The corrections are prolongated bilinearly, P = 2 P_b, the positions are restricted
+     * by full weighting (halved) and the gradients by P^T.
+     *
+     * The objective of level l + 1 is 4 f_{l+1}(x) - v^T x: the factor 4 matches its Hessian
+     * with the Galerkin P^T H_l P of the level above, and v makes its gradient at the
+     * restricted point equal to P^T g_l, so that the prolongated coarse correction is a
+     * descent direction for the level above, where it is applied with a line search.
+     *
+     * A V-cycle smooths each level with a few gradient steps, each with a backtracking line
+     * search started from twice the level's previous step, and takes a regularized Newton
+     * step on the coarsest level. More work on the coarse levels does not pay off: with
+     * the springs with length, the linear term can pull a coarse level far from the
+     * restricted point, into another of the energy's minima. */
+    template<class MassSpringProblem>
+    class MassSpringMultiGridT {
+    public:
+        using Vec = Eigen::VectorXd;
+        using SMat = Eigen::SparseMatrix<double>;
+        using MassSpringSystem = MassSpringSystemT<MassSpringProblem>;
+
+        /**
+         * \param _n_grid_x, _n_grid_y the fine grid, as for MassSpringSystemT
+         * \param _spring_element_type the spring element type of the fine problem
+         * \param _scenario the constrained spring elements of the fine problem, 0 for none
+         * \param _n_coarsest the minimal grid size of the coarse levels */
+        MassSpringMultiGridT(const int _n_grid_x, const int _n_grid_y, const int _spring_element_type = 0,
+                             const int _scenario = 0, const int _n_coarsest = 2) {
+            levels_.emplace_back(new Level(_n_grid_x, _n_grid_y, 1.));
+            while(levels_.back()->nx % 2 == 0 && levels_.back()->ny % 2 == 0
+                  && levels_.back()->nx / 2 >= _n_coarsest && levels_.back()->ny / 2 >= _n_coarsest) {
+                const Level& fine = *levels_.back();
+                levels_.emplace_back(new Level(fine.nx / 2, fine.ny / 2, 4. * fine.problem.scale()));
+
+                Level& coarse = *levels_.back();
+                coarse.mss = std::make_shared<MassSpringSystem>(coarse.nx, coarse.ny, _spring_element_type);
+                if(_scenario != 0)
+                    coarse.mss->add_constrained_spring_elements(_scenario);
+                coarse.problem.set_function(coarse.mss->get_problem().get());
+                coarse.v.setZero(2 * coarse.n_nodes());
+                coarse.problem.set_linear_term(&coarse.v);
+            }
+        }
+
+        ~MassSpringMultiGridT() {}
+
+        size_t n_levels() const {
+            return levels_.size();
+        }
+
+        // grid size of a level, 0 being the finest
+        int n_grid_x(const int _level) const { return levels_[_level]->nx; }
+        int n_grid_y(const int _level) const { return levels_[_level]->ny; }
+
+        // number of V-cycles of the last solve
+        int n_cycles() const { return n_cycles_; }
+
+        // the mass spring system of a coarse level (_level > 0)
+        std::shared_ptr<MassSpringSystem> get_system(const int _level) const {
+            return levels_[_level]->mss;
+        }
+
+        /** Runs V-cycles on the fine problem.
+         * \param _problem the fine problem, on the (n_grid_x+1) x (n_grid_y+1) grid, which can
+         *        be any FunctionBaseSparse, e.g. an OptimizationStatistic of the MSP
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient norm
+         * \param _max_cycles a capping number of V-cycles
+         * \param _n_smooth the number of pre- and post-smoothing steps
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4, const int _max_cycles = 100,
+                  const int _n_smooth = 2) {
+            std::cout << "******** Multigrid ********" << std::endl;
+
+            if(_problem->n_unknowns() != 2 * levels_[0]->n_nodes()) {
+                std::cout << "Warning: the problem does not match the " << levels_[0]->nx << "x" << levels_[0]->ny
+                          << " grid, returning the initial point" << std::endl;
+                return _initial_x;
+            }
+
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            n_smooth_ = _n_smooth;
+            n_skipped_ = 0;
+            for(auto& level : levels_)
+                level->step = 1.;
+            levels_[0]->problem.set_function(_problem);
+
+            Vec x = _initial_x;
+            int cycle(0);
+
+            while (cycle < _max_cycles) {
+                const double f_x = levels_[0]->problem.eval_f_and_gradient(x, levels_[0]->g);
+                if (levels_[0]->g.squaredNorm() < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: "
+                              << levels_[0]->g.squaredNorm() << std::endl;
+                    break;
+                }
+
+                v_cycle(0, x);
+                cycle++;
+
+                if (cycle % 10 == 0) {
+                    std::cout << "Cycle " << cycle << " | f(x) = " << f_x << " | ||g|| = " << levels_[0]->g.norm() << std::endl;
+                }
+            }
+
+            if (cycle == _max_cycles) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            n_cycles_ = cycle;
+            std::cout << "Cycles: " << cycle << " | levels: " << levels_.size() << " (coarsest "
+                      << levels_.back()->nx << "x" << levels_.back()->ny << ") | skipped corrections: " << n_skipped_ << std::endl;
+
+            levels_[0]->problem.set_function(nullptr);
+            return x;
+        }
+
+        /** bilinear interpolation of the coarse _level + 1 nodal values to _level
+         * \param _coarse 2 values per node of the coarse level
+         * \param _fine output, 2 values per node of _level */
+        void prolongate(const int _level, const Vec& _coarse, Vec& _fine) const {
+            const Level& fine = *levels_[_level];
+            const int cnx = levels_[_level + 1]->nx + 1;
+            _fine.resize(2 * fine.n_nodes());
+
+            for(int j = 0; j <= fine.ny; ++j)
+                for(int i = 0; i <= fine.nx; ++i) {
+                    const int f = 2 * ((fine.nx + 1) * j + i);
+                    const int i0 = i / 2, i1 = (i + 1) / 2, j0 = j / 2, j1 = (j + 1) / 2;
+                    for(int c = 0; c < 2; ++c)
+                        _fine[f + c] = 0.25 * (_coarse[2 * (cnx * j0 + i0) + c] + _coarse[2 * (cnx * j0 + i1) + c]
+                                             + _coarse[2 * (cnx * j1 + i0) + c] + _coarse[2 * (cnx * j1 + i1) + c]);
+                }
+        }
+
+        /** transpose of prolongate, i.e. the bilinear restriction of nodal sums such as gradients
+         * \param _fine 2 values per node of _level
+         * \param _coarse output, 2 values per node of the coarse _level + 1 */
+        void restrict_sum(const int _level, const Vec& _fine, Vec& _coarse) const {
+            const Level& fine = *levels_[_level];
+            const int cnx = levels_[_level + 1]->nx + 1;
+            _coarse.setZero(2 * levels_[_level + 1]->n_nodes());
+
+            for(int j = 0; j <= fine.ny; ++j)
+                for(int i = 0; i <= fine.nx; ++i) {
+                    const int f = 2 * ((fine.nx + 1) * j + i);
+                    const int i0 = i / 2, i1 = (i + 1) / 2, j0 = j / 2, j1 = (j + 1) / 2;
+                    for(int c = 0; c < 2; ++c) {
+                        const double value = 0.25 * _fine[f + c];
+                        _coarse[2 * (cnx * j0 + i0) + c] += value;
+                        _coarse[2 * (cnx * j0 + i1) + c] += value;
+                        _coarse[2 * (cnx * j1 + i0) + c] += value;
+                        _coarse[2 * (cnx * j1 + i1) + c] += value;
+                    }
+                }
+        }
+
+        /** full weighting of the node positions of _level, in the coordinates of the coarse
+         * _level + 1, i.e. divided by 2
+         * \param _fine the positions of _level
+         * \param _coarse output, the positions of the coarse _level + 1 */
+        void restrict_positions(const int _level, const Vec& _fine, Vec& _coarse) const {
+            const Level& fine = *levels_[_level];
+            const Level& coarse = *levels_[_level + 1];
+            const int cnx = coarse.nx + 1;
+            _coarse.setZero(2 * coarse.n_nodes());
+
+            // full weighting stencil, (1/2, 1, 1/2) in each direction, reduced to the middle
+            // node in the directions of the boundary so that it stays exact for linear positions
+            for(int J = 0; J <= coarse.ny; ++J)
+                for(int I = 0; I <= coarse.nx; ++I) {
+                    double weight_sum(0);
+                    const int C = 2 * (cnx * J + I);
+                    const int dj = (J == 0 || J == coarse.ny) ? 0 : 1;
+                    const int di = (I == 0 || I == coarse.nx) ? 0 : 1;
+                    for(int j = 2 * J - dj; j <= 2 * J + dj; ++j)
+                        for(int i = 2 * I - di; i <= 2 * I + di; ++i) {
+                            const double weight = (i == 2 * I ? 1. : 0.5) * (j == 2 * J ? 1. : 0.5);
+                            const int f = 2 * ((fine.nx + 1) * j + i);
+                            _coarse[C] += weight * _fine[f];
+                            _coarse[C + 1] += weight * _fine[f + 1];
+                            weight_sum += weight;
+                        }
+                    _coarse[C] *= 0.5 / weight_sum;
+                    _coarse[C + 1] *= 0.5 / weight_sum;
+                }
+        }
+
+    private:
+        /* The objective of a level, _scale * f(x) - v^T x, f being the level's problem
+         * and v its linear term, if any */
+        class LevelProblem : public FunctionBaseSparse {
+        public:
+            explicit LevelProblem(const double _scale) : f_(nullptr), scale_(_scale), v_(nullptr) {}
+
+            void set_function(FunctionBaseSparse* _f) { f_ = _f; }
+            void set_linear_term(const Vec* _v) { v_ = _v; }
+            double scale() const { return scale_; }
+
+            virtual int n_unknowns() override {
+                return f_->n_unknowns();
+            }
+
+            virtual double eval_f(const Vec &_x) override {
+                const double f = scale_ * f_->eval_f(_x);
+                return v_ ? f - v_->dot(_x) : f;
+            }
+
+            virtual void eval_gradient(const Vec &_x, Vec &_g) override {
+                f_->eval_gradient(_x, _g);
+                finish_gradient(_g);
+            }
+
+            virtual double eval_f_and_gradient(const Vec &_x, Vec &_g) override {
+                const double f = scale_ * f_->eval_f_and_gradient(_x, _g);
+                finish_gradient(_g);
+                return v_ ? f - v_->dot(_x) : f;
+            }
+
+            virtual void eval_hessian(const Vec &_x, SMat &_h) override {
+                f_->eval_hessian(_x, _h);
+                if(scale_ != 1.)
+                    _h *= scale_;
+            }
+
+        private:
+            void finish_gradient(Vec &_g) const {
+                if(scale_ != 1.)
+                    _g *= scale_;
+                if(v_)
+                    _g -= *v_;
+            }
+
+            FunctionBaseSparse* f_;
+            double scale_;
+            const Vec* v_;
+        };
+
+        struct Level {
+            Level(const int _nx, const int _ny, const double _scale) : nx(_nx), ny(_ny), problem(_scale) {}
+
+            int n_nodes() const { return (nx + 1) * (ny + 1); }
+
+            int nx, ny;
+            // the system of a coarse level
+            std::shared_ptr<MassSpringSystem> mss;
+            LevelProblem problem;
+            // linear term of the objective, and the restricted point and iterate of a coarse level
+            Vec v, x0, x;
+            // work storage
+            Vec g, dx, x_new;
+            SMat H;
+            NewtonMethod::RegularizedLDLT ldlt;
+            double step = 1.;
+        };
+
+        void v_cycle(const int _l, Vec& _x) {
+            Level& level = *levels_[_l];
+            if(_l + 1 == static_cast<int>(levels_.size())) {
+                coarsest_solve(level, _x);
+                return;
+            }
+
+            smooth(level, _x);
+
+            // coarse objective, first-order coherent with this level's at the restricted point
+            Level& coarse = *levels_[_l + 1];
+            const double f_x = level.problem.eval_f_and_gradient(_x, level.g);
+            restrict_positions(_l, _x, coarse.x0);
+            coarse.v.setZero();
+            coarse.problem.eval_gradient(coarse.x0, coarse.g);
+            restrict_sum(_l, level.g, coarse.v);
+            coarse.v = coarse.g - 2. * coarse.v;
+
+            coarse.x = coarse.x0;
+            v_cycle(_l + 1, coarse.x);
+
+            // prolongated correction, P = 2 P_b
+            coarse.x -= coarse.x0;
+            prolongate(_l, coarse.x, level.dx);
+            level.dx *= 2.;
+            if(level.g.dot(level.dx) < 0.) {
+                const double t = LineSearch::backtracking_line_search(&level.problem, _x, f_x, level.g, level.dx, 1.0, level.x_new);
+                _x += t * level.dx;
+            } else {
+                ++n_skipped_;
+            }
+
+            smooth(level, _x);
+        }
+
+        // gradient steps, from twice the previous step length
+        void smooth(Level& _level, Vec& _x) {
+            for(int s = 0; s < n_smooth_; ++s) {
+                const double f_x = _level.problem.eval_f_and_gradient(_x, _level.g);
+                if(_level.g.squaredNorm() == 0.)
+                    return;
+
+                _level.dx = -_level.g;
+                _level.step = LineSearch::backtracking_line_search(&_level.problem, _x, f_x, _level.g, _level.dx,
+                                                                   2. * _level.step, _level.x_new);
+                _x += _level.step * _level.dx;
+            }
+        }
+
+        // a regularized Newton step
+        void coarsest_solve(Level& _level, Vec& _x) {
+            const double f_x = _level.problem.eval_f_and_gradient(_x, _level.g);
+            if(_level.g.squaredNorm() == 0.)
+                return;
+
+            _level.problem.eval_hessian(_x, _level.H);
+            if(!_level.ldlt.compute(_level.H))
+                return;
+            _level.ldlt.solve(_level.g, _level.dx);
+            _level.dx *= -1.;
+
+            const double t = LineSearch::backtracking_line_search(&_level.problem, _x, f_x, _level.g, _level.dx, 1.0, _level.x_new);
+            _x += t * _level.dx;
+        }
+
+    private:
+        std::vector<std::unique_ptr<Level>> levels_;
+
+        int n_smooth_ = 2;
+        int n_skipped_ = 0;
+        int n_cycles_ = 0;
+    };
+
+//=============================================================================
+}
+//=============================================================================
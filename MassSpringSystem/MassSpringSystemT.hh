@@ -4,9 +4,12 @@
 
 #include <Functions/MassSpringProblem2DDense.hh>
 #include <Functions/MassSpringProblem2DSparse.hh>
+#include <Functions/MassSpringProblem2DSparseT.hh>
+#include <Functions/MassSpringProblem2DLeastSquares.hh>
 
 #include <Functions/SpringElement2D.hh>
 #include <Functions/SpringElement2DWithLength.hh>
+#include <Functions/SpringElement2DWithLengthPSDHessian.hh>
 
 
 #include <Utils/RandomNumberGenerator.hh>
@@ -33,7 +36,17 @@ namespace AOPT {
      * Templates are an advanced feature of the C++ language so feel free to find
      * more information on this subject online.
      * For now, you can simply have a look at the MassSpringSystemT_impl.hh for
-     * an example of implementation. */
+     * an example of implementation.
+     *
+     * Besides MassSpringProblem2DDense and MassSpringProblem2DSparse, the MSP can be
+     * a statically-dispatched MassSpringProblem2DSparseT, e.g.
+     * MassSpringSystemT<MassSpringProblem2DSparseT<SpringElement2DWithLength>>, in which
+     * case the spring element type given to the constructor should match.
+     *
+     * With _least_square, the MSP is a MassSpringProblem2DLeastSquares, which gives
+     * the residuals and Jacobian used by the LevenbergMarquardt solver. This requires
+     * a MassSpringProblem it converts to, i.e. MassSpringProblem2DSparse or
+     * MassSpringProblem2DLeastSquares. */
     template<class MassSpringProblem>
     class MassSpringSystemT {
     public:
@@ -77,6 +90,13 @@ namespace AOPT {
 
         int get_grid_index(const int _i, const int _j) const;
 
+        // least-squares problem with the given spring element, selected by the type of the
+        // last argument, i.e. only for the MSPs a MassSpringProblem2DLeastSquares converts to
+        template<class Problem>
+        std::shared_ptr<Problem> make_least_squares_problem(ParametricFunctionBase& _spring, Problem*) const;
+        std::shared_ptr<MassSpringProblem2DSparse> make_least_squares_problem(ParametricFunctionBase& _spring, MassSpringProblem2DSparse*) const;
+        std::shared_ptr<MassSpringProblem2DLeastSquares> make_least_squares_problem(ParametricFunctionBase& _spring, MassSpringProblem2DLeastSquares*) const;
+
     private:
         int n_grid_x_;
         int n_grid_y_;
@@ -88,6 +108,7 @@ namespace AOPT {
 
         SpringElement2D se_;
         SpringElement2DWithLength sewl_;
+        SpringElement2DWithLengthPSDHessian sewl_psd_;
         
 
         std::shared_ptr<MassSpringProblem> msp_;
@@ -38,13 +38,26 @@ namespace AOPT {
 
         // Initialize the problem pointer
         if (_least_square) {
-            // Least square (Gauss-Newton) configuration if applicable
-            // Implementation details would go here if specified
+            // Least square (Gauss-Newton) configuration, the residual forms of the elements
+            // are the same for WITH_LENGTH and WITH_LENGTH_PSD_HESS
+            if (_spring_element_type == WITH_LENGTH || _spring_element_type == WITH_LENGTH_PSD_HESS) {
+                msp_ = make_least_squares_problem(sewl_, static_cast<MassSpringProblem*>(nullptr));
+            } else if (_spring_element_type == WITHOUT_LENGTH) {
+                msp_ = make_least_squares_problem(se_, static_cast<MassSpringProblem*>(nullptr));
+            } else {
+                std::cout << "Error: spring function index should be 0, 1, or 2!" << std::endl;
+                return;
+            }
+            if (msp_ == nullptr)
+                return;
         } else {  // Normal problem configuration
             if (_spring_element_type == WITH_LENGTH) {
                 msp_ = std::make_shared<MassSpringProblem>(sewl_, n_unknowns_);
             } else if (_spring_element_type == WITHOUT_LENGTH) {
                 msp_ = std::make_shared<MassSpringProblem>(se_, n_unknowns_);
+            } else if (_spring_element_type == WITH_LENGTH_PSD_HESS) {
+                // same energy as WITH_LENGTH with positive semi-definite Hessians
+                msp_ = std::make_shared<MassSpringProblem>(sewl_psd_, n_unknowns_);
             } else {
                 std::cout << "Error: spring function index should be 0, 1, or 2!" << std::endl;
                 return;
@@ -114,6 +127,26 @@ namespace AOPT {
         return points;
     }
 
+    template<class MassSpringProblem>
+    template<class Problem>
+    std::shared_ptr<Problem>
+    MassSpringSystemT<MassSpringProblem>::make_least_squares_problem(ParametricFunctionBase& /*_spring*/, Problem*) const {
+        std::cout << "Error: least-squares problems require MassSpringProblem2DSparse or MassSpringProblem2DLeastSquares!" << std::endl;
+        return nullptr;
+    }
+
+    template<class MassSpringProblem>
+    std::shared_ptr<MassSpringProblem2DSparse>
+    MassSpringSystemT<MassSpringProblem>::make_least_squares_problem(ParametricFunctionBase& _spring, MassSpringProblem2DSparse*) const {
+        return std::make_shared<MassSpringProblem2DLeastSquares>(_spring, n_unknowns_);
+    }
+
+    template<class MassSpringProblem>
+    std::shared_ptr<MassSpringProblem2DLeastSquares>
+    MassSpringSystemT<MassSpringProblem>::make_least_squares_problem(ParametricFunctionBase& _spring, MassSpringProblem2DLeastSquares*) const {
+        return std::make_shared<MassSpringProblem2DLeastSquares>(_spring, n_unknowns_);
+    }
+
     template<class MassSpringProblem>
     int MassSpringSystemT<MassSpringProblem>::get_grid_index(const int _i, const int _j) const {
         assert(_i <= n_grid_x_ && _j <= n_grid_y_);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <FunctionBase/FunctionBaseSparse.hh>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    /* Performs Nesterov's accelerated gradient method (FISTA) on a given problem.
+     * Each iteration takes a gradient step x_{k+1} = y_k - g(y_k) / L from the
+     * extrapolated point y_k = x_k + beta_k (x_k - x_{k-1}), with the momentum
+     * beta_k = (t_k - 1) / t_{k+1}, t_{k+1} = (1 + sqrt(1 + 4 t_k^2)) / 2, which gives
+     * the O(1/k^2) rate on smooth convex functions instead of the gradient descent's O(1/k).
+     *
+     * The Lipschitz constant L of the gradient is estimated by backtracking: L is doubled
+     * until f(x_{k+1}) <= f(y_k) - ||g(y_k)||^2 / (2L), and slightly decreased at each
+     * iteration so that it follows the local curvature.
+     *
+     * Since the momentum makes f oscillate when it overshoots, it can be reset (t = 1)
+     * with the adaptive restart of O'Donoghue and Candes, either when
+     * g(y_k)^T (x_{k+1} - x_k) > 0 (GRADIENT_RESTART) or when f(x_{k+1}) > f(x_k)
+     * (FUNCTION_RESTART), which recovers the linear rate on strongly convex problems. */
+    class AcceleratedGradient {
+    public:
+        typedef FunctionBaseSparse::Vec Vec; ///< Eigen::VectorXd
+
+        enum Restart {
+            NO_RESTART,
+            FUNCTION_RESTART,
+            GRADIENT_RESTART
+        };
+
+
+        /**
+         * \param _problem a pointer to a specific Problem, which can be any type that
+         *        has the same interface as FunctionBase's (i.e. with eval_f, eval_gradient, etc.)
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient norm
+         * \param _max_iters a capping number of iterations
+         * \param _restart the adaptive restart scheme of the momentum
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4,
+                         const int _max_iters = 1000000, const Restart _restart = GRADIENT_RESTART) {
+            std::cout << "******** Accelerated Gradient ********" << std::endl;
+
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            const int n = _problem->n_unknowns();
+
+            // get starting point, the extrapolated point y starts at x
+            Vec x = _initial_x;
+            Vec x_prev = x, y = x;
+            Vec g(n), x_new(n);
+            int iter(0), n_restarts(0);
+
+            double f_x = _problem->eval_f(x);
+            double L = 1.0, t = 1.0;
+
+            while (iter < _max_iters) {
+                const double f_y = _problem->eval_f_and_gradient(y, g);
+                const double g2 = g.squaredNorm();
+
+                // Check stopping criterion
+                if (g2 < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g2 << std::endl;
+                    std::swap(x, y);
+                    break;
+                }
+
+                // gradient step from y, with the backtracking estimate of L
+                double f_new;
+                while (true) {
+                    x_new = y - g / L;
+                    f_new = _problem->eval_f(x_new);
+                    if (f_new <= f_y - 0.5 / L * g2)
+                        break;
+                    L *= 2.;
+                }
+
+                // adaptive restart
+                bool restart(false);
+                if (_restart == GRADIENT_RESTART)
+                    restart = g.dot(x_new) - g.dot(x) > 0.;
+                else if (_restart == FUNCTION_RESTART)
+                    restart = f_new > f_x;
+                if (restart) {
+                    t = 1.;
+                    ++n_restarts;
+                }
+
+                const double t_new = 0.5 * (1. + std::sqrt(1. + 4. * t * t));
+                const double beta = (t - 1.) / t_new;
+                t = t_new;
+
+                std::swap(x_prev, x);
+                std::swap(x, x_new);
+                f_x = f_new;
+                y = x + beta * (x - x_prev);
+
+                // let the estimate decrease again where the function is flatter
+                L *= 0.9;
+                iter++;
+
+                // Output progress
+                if (iter % 1000 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << std::sqrt(g2)
+                              << " | L = " << L << std::endl;
+                }
+            }
+
+            // Check if max iterations were reached
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            std::cout << "Iterations: " << iter << " | restarts: " << n_restarts << " | L = " << L << std::endl;
+
+            return x;
+        }
+    };
+}
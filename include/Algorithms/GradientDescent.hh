@@ -2,7 +2,12 @@
 
 #include <FunctionBase/FunctionBaseSparse.hh>
 #include "LineSearch.hh"
+#include <Utils/LipschitzEstimator.hh>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 //== NAMESPACES ===============================================================
 
@@ -10,11 +15,55 @@ namespace AOPT {
 
     /* Performs a gradient descent on a given problem.
      * This can work with any Problem with a FunctionBase-style interface since
-     * the gradient descent method is rather generic mathematically */
+     * the gradient descent method is rather generic mathematically
+     *
+     * The step length is either found by a backtracking line search started from
+     * the previous step (BACKTRACKING), or is the Barzilai-Borwein spectral step
+     * (BB1, BB2) computed from s = x_k - x_{k-1} and y = g_k - g_{k-1}:
+     *   BB1: t = s^T s / s^T y,   BB2: t = s^T y / y^T y,
+     * which can grow again when the function gets flatter. The BB step is accepted if
+     * it satisfies the nonmonotone Armijo condition of Grippo, Lampariello and Lucidi,
+     * f(x - t g) <= max of the last _memory f values - 1e-4 t ||g||^2, and only when this
+     * safeguard trips does the backtracking line search run, so most iterations cost
+     * a single evaluation of f and g.
+     *
+     * The backtracking line search can also use this nonmonotone condition (NONMONOTONE_MAX),
+     * or the one of Zhang and Hager with a weighted average of all the previous f values
+     * as reference (NONMONOTONE_AVERAGE, see LineSearch::NonmonotoneReference), which
+     * let f increase for a few iterations in the narrow curved valleys of the springs
+     * with length.
+     * As the backtracking from the previous step never lengthens it, these line searches
+     * start from a step 4/3 longer every _memory iterations, which the nonmonotone
+     * condition mostly accepts.
+     *
+     * For the problems which are polynomials along lines, such as the mass spring
+     * problems, the step can also be the exact minimizer along -g (EXACT, see
+     * LineSearch::exact_line_search), the backtracking line search being the fallback
+     * for the other problems.
+     *
+     * The step can also be fixed to 1/L (FIXED_STEP), with L the largest eigenvalue of the
+     * Hessian at the initial point (see LipschitzEstimator). When the Hessian is constant,
+     * as for the springs without length, f(x - g/L) <= f(x) - ||g||^2 / (2L) holds at every
+     * step, so the iterations need no line search and cost a single evaluation of f and g.
+     * This sufficient decrease is checked on the new f, and if it ever fails, the
+     * backtracking line search shortens the step, which is kept for the next iterations.
+     *
+     * With _n_threads > 1, the backtracking line search evaluates _n_threads trial steps
+     * at once (LineSearch::speculative_line_search), which gives the same steps. */
     class GradientDescent {
     public:
         typedef FunctionBaseSparse::Vec Vec; ///< Eigen::VectorXd
 
+        enum StepRule {
+            BACKTRACKING,        ///< backtracking line search from the previous step
+            BB1,                 ///< long Barzilai-Borwein step s^T s / s^T y
+            BB2,                 ///< short Barzilai-Borwein step s^T y / y^T y
+            EXACT,               ///< exact minimizer of the line polynomial
+            NONMONOTONE_MAX,     ///< backtracking with the Grippo-Lampariello-Lucidi condition
+            NONMONOTONE_AVERAGE, ///< backtracking with the Zhang-Hager condition
+            FIXED_STEP           ///< step 1/L, backtracking if the sufficient decrease fails
+        };
+
 
         /**
          * \param _problem a pointer to a specific Problem, which can be any type that
@@ -26,30 +75,56 @@ namespace AOPT {
          *             bad configuration where the successive attempts of finding the
          *             minimum kind of oscillate around the actual minimum without
          *             finding it
+         * \param _step_rule how the step length is chosen, see StepRule
+         * \param _memory number of previous function values of the nonmonotone safeguard
+         *        of the Barzilai-Borwein steps and of the NONMONOTONE_MAX condition, and
+         *        period of the longer trial steps of the nonmonotone line searches
+         * \param _n_threads number of threads of the backtracking line search
          *
          * \return the minimum found by the method. */
         template <class Problem>
-        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4, const int _max_iters = 1000000) {
+        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4, const int _max_iters = 1000000,
+                         const StepRule _step_rule = BACKTRACKING, const int _memory = 10, const int _n_threads = 1) {
             std::cout << "******** Gradient Descent ********" << std::endl;
 
+            if (_step_rule == BB1 || _step_rule == BB2)
+                return solve_barzilai_borwein(_problem, _initial_x, _eps, _max_iters, _step_rule, _memory);
+            if (_step_rule == FIXED_STEP)
+                return solve_fixed_step(_problem, _initial_x, _eps, _max_iters);
+
             // squared epsilon for stopping criterion
             double e2 = _eps * _eps;
 
             // get starting point
             Vec x = _initial_x;
 
-            // allocate gradient storage
+            // allocate gradient storage, as well as the search direction and the line
+            // search's trial points, so that the iterations do not allocate any memory
             Vec g(_problem->n_unknowns());
-            int iter(0);
+            Vec dx(_problem->n_unknowns());
+            LineSearch::SpeculativeTrials trials(_n_threads, _problem->n_unknowns());
+            // coefficients of the line polynomial of the exact steps
+            Vec p(5);
+            // reference value of the Armijo condition, f(x) for the monotone line search
+            const bool nonmonotone = _step_rule == NONMONOTONE_MAX || _step_rule == NONMONOTONE_AVERAGE;
+            const int memory = std::max(_memory, 1);
+            LineSearch::NonmonotoneReference f_ref(_step_rule == NONMONOTONE_MAX ? memory : 1,
+                    _step_rule == NONMONOTONE_AVERAGE ? LineSearch::NonmonotoneReference::AVERAGE
+                                                      : LineSearch::NonmonotoneReference::MAX);
+            int iter(0), n_fallbacks(0);
 
             //------------------------------------------------------//
             //TODO: implement the gradient descent
             double alpha = 1.0;     // Initial step size
-            double f_x = _problem->eval_f(x);  // Initial function value
+            double f_x = 0.0;
 
             while (iter < _max_iters) {
-                // Compute the gradient at the current point
-                _problem->eval_gradient(x, g);
+                // Compute function value and gradient at the current point in one pass
+                f_x = _problem->eval_f_and_gradient(x, g);
+                if (iter == 0)
+                    f_ref.reset(f_x);
+                else
+                    f_ref.push(f_x);
 
                 // Check stopping criterion
                 if (g.squaredNorm() < e2) {
@@ -57,19 +132,82 @@ namespace AOPT {
                     break;
                 }
 
-                // Perform backtracking line search to find a suitable step size
-                double f_x = _problem->eval_f(x); // Replace this with your actual evaluation method
-                Vec f_x_vec(1);                       // Create a Vec of size 1 to hold the function value
-                f_x_vec(0) = f_x;                     // Assign the double to the Vec
-                alpha = LineSearch::backtracking_line_search(_problem, x, g, f_x_vec, alpha);
+                // Perform backtracking line search along -g, reusing f(x) as reference
+                dx = -g;
+                const double t = _step_rule == EXACT ? LineSearch::exact_line_search(_problem, x, dx, p) : 0.;
+                if (t > 0.) {
+                    alpha = t;
+                } else {
+                    // the nonmonotone line searches try a longer step every memory iterations
+                    const double t0 = (nonmonotone && iter % memory == 0) ? alpha / 0.75 : alpha;
+                    alpha = LineSearch::speculative_line_search(_problem, x, f_ref.value(), g, dx, t0, trials, _n_threads);
+                    if (_step_rule == EXACT)
+                        ++n_fallbacks;
+                }
 
+                // Update x using the gradient and step size
+                x -= alpha * g;
+                iter++;
 
+                // Output progress
+                if (iter % 1000 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g.norm() << std::endl;
+                }
+            }
 
-                // Update x using the gradient and step size
-                x = x - alpha * g;
+            // Check if max iterations were reached
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            std::cout << "Iterations: " << iter;
+            if (_step_rule == EXACT)
+                std::cout << " | backtracking fallbacks: " << n_fallbacks;
+            std::cout << std::endl;
+            //------------------------------------------------------//
+
+            return x;
+        }
 
-                // Update function value and iteration count
-                f_x = _problem->eval_f(x);
+    private:
+        template <class Problem>
+        static Vec solve_fixed_step(Problem *_problem, const Vec& _initial_x, const double _eps, const int _max_iters) {
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            // get starting point
+            Vec x = _initial_x;
+
+            const int n = _problem->n_unknowns();
+            Vec g(n), g_new(n), dx(n), x_new(n);
+            int iter(0), n_backtracking(0);
+
+            const double L = LipschitzEstimator::largest_eigenvalue(_problem, x);
+            double alpha = L > 0. ? 1. / L : 1.;
+            double f_x = _problem->eval_f_and_gradient(x, g);
+
+            while (iter < _max_iters) {
+                // Check stopping criterion
+                const double g2 = g.squaredNorm();
+                if (g2 < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g2 << std::endl;
+                    break;
+                }
+
+                dx = -g;
+                x_new = x + alpha * dx;
+                double f_new = _problem->eval_f_and_gradient(x_new, g_new);
+
+                if (!(f_new <= f_x - 0.5 * alpha * g2)) {
+                    // the step is too long for the curvature here, Armijo backtracking with the
+                    // same sufficient decrease from the rejected step
+                    alpha = LineSearch::backtracking_line_search(_problem, x, f_x, g, dx, 0.75 * alpha, x_new, &f_new);
+                    _problem->eval_gradient(x_new, g_new);
+                    ++n_backtracking;
+                }
+
+                std::swap(x, x_new);
+                std::swap(g, g_new);
+                f_x = f_new;
                 iter++;
 
                 // Output progress
@@ -82,7 +220,76 @@ namespace AOPT {
             if (iter == _max_iters) {
                 std::cout << "Maximum iterations reached without convergence." << std::endl;
             }
-            //------------------------------------------------------//
+            std::cout << "Iterations: " << iter << " | L estimate: " << L << " | step: " << alpha
+                      << " | backtracking: " << n_backtracking << std::endl;
+
+            return x;
+        }
+
+        template <class Problem>
+        static Vec solve_barzilai_borwein(Problem *_problem, const Vec& _initial_x, const double _eps, const int _max_iters,
+                                          const StepRule _step_rule, const int _memory) {
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            // get starting point
+            Vec x = _initial_x;
+
+            const int n = _problem->n_unknowns();
+            Vec g(n), g_new(n), dx(n), x_new(n), y(n);
+            int iter(0), n_backtracking(0);
+
+            double f_x = _problem->eval_f_and_gradient(x, g);
+            // last function values, for the nonmonotone safeguard
+            LineSearch::NonmonotoneReference f_ref(_memory);
+            f_ref.reset(f_x);
+            double alpha = 1.0;
+
+            while (iter < _max_iters) {
+                // Check stopping criterion
+                if (g.squaredNorm() < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g.squaredNorm() << std::endl;
+                    break;
+                }
+
+                dx = -g;
+                x_new = x + alpha * dx;
+                double f_new = _problem->eval_f_and_gradient(x_new, g_new);
+
+                if (!(f_new <= f_ref.value() + 1e-4 * alpha * g.dot(dx))) {
+                    // the safeguard tripped, monotone Armijo backtracking from the rejected step
+                    alpha = LineSearch::backtracking_line_search(_problem, x, f_x, g, dx, 0.5 * alpha, x_new, &f_new);
+                    _problem->eval_gradient(x_new, g_new);
+                    ++n_backtracking;
+                }
+
+                // spectral step for the next iteration, with s = alpha * dx
+                y = g_new - g;
+                const double sy = alpha * dx.dot(y);
+                const double step = alpha;
+                if (sy > 0.) {
+                    alpha = (_step_rule == BB1) ? step * step * dx.squaredNorm() / sy : sy / y.squaredNorm();
+                    alpha = std::min(std::max(alpha, 1e-10), 1e10);
+                }
+
+                std::swap(x, x_new);
+                std::swap(g, g_new);
+                f_x = f_new;
+                f_ref.push(f_x);
+                iter++;
+
+                // Output progress
+                if (iter % 1000 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g.norm()
+                              << " | step = " << step << std::endl;
+                }
+            }
+
+            // Check if max iterations were reached
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            std::cout << "Iterations: " << iter << " | safeguard backtracking: " << n_backtracking << std::endl;
 
             return x;
         }
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <FunctionBase/FunctionBaseSparse.hh>
+#include "LineSearch.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    /* Performs the limited-memory BFGS method on a given problem.
+     * Like the gradient descent, it only needs function values and gradients, so it
+     * works with any Problem with a FunctionBase-style interface.
+     *
+     * The inverse Hessian approximation is implicitly given by the last m pairs
+     * s_k = x_{k+1} - x_k and y_k = g_{k+1} - g_k, which are kept in a ring buffer
+     * of m columns allocated once, and applied to the gradient with the two-loop
+     * recursion. The steps are computed by a Wolfe line search, which guarantees
+     * s_k^T y_k > 0 on smooth problems. Pairs with s_k^T y_k <= 0 (possible when the
+     * line search falls back) are not stored, since they would make the
+     * approximation indefinite. */
+    class LBFGS {
+    public:
+        typedef FunctionBaseSparse::Vec Vec; ///< Eigen::VectorXd
+        typedef FunctionBaseSparse::Mat Mat; ///< Eigen::MatrixXd
+
+
+        /**
+         * \param _problem a pointer to a specific Problem, which can be any type that
+         *        has the same interface as FunctionBase's (i.e. with eval_f, eval_gradient, etc.)
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient norm
+         * \param _max_iters a capping number of iterations
+         * \param _m the number of (s, y) pairs kept, usually between 3 and 20
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4,
+                         const int _max_iters = 10000, const int _m = 7) {
+            std::cout << "******** LBFGS ********" << std::endl;
+
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            const int n = _problem->n_unknowns();
+            const int m = std::max(1, _m);
+
+            // get starting point
+            Vec x = _initial_x;
+
+            // all the storage is allocated here, the iterations do not allocate memory
+            Vec g(n), dx(n), x_new(n), g_new(n);
+            // ring buffer of the pairs, the newest being at column (first + size - 1) % m
+            Mat S(n, m), Y(n, m);
+            Vec rho(m), alpha(m);
+            int first(0), size(0);
+
+            int iter(0), n_skipped(0);
+            double f_x = _problem->eval_f_and_gradient(x, g);
+            double f_new(0);
+
+            while (iter < _max_iters) {
+                if (g.squaredNorm() < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g.squaredNorm() << std::endl;
+                    break;
+                }
+
+                // two-loop recursion, dx = -H_k g
+                dx = g;
+                for (int i = size - 1; i >= 0; --i) {
+                    const int k = (first + i) % m;
+                    alpha[k] = rho[k] * S.col(k).dot(dx);
+                    dx -= alpha[k] * Y.col(k);
+                }
+                if (size > 0) {
+                    // H_0 = gamma I, scaled by the newest pair
+                    const int k = (first + size - 1) % m;
+                    dx *= 1. / (rho[k] * Y.col(k).squaredNorm());
+                }
+                for (int i = 0; i < size; ++i) {
+                    const int k = (first + i) % m;
+                    const double beta = rho[k] * Y.col(k).dot(dx);
+                    dx += (alpha[k] - beta) * S.col(k);
+                }
+                dx *= -1.;
+
+                // without curvature information, the first step has length 1
+                const double t0 = size > 0 ? 1. : std::min(1., 1. / std::sqrt(g.squaredNorm()));
+                double t = LineSearch::wolfe_line_search(_problem, x, f_x, g, dx, t0, x_new, g_new, f_new);
+
+                if (t == 0.) {
+                    if (size == 0) {
+                        std::cout << "Warning: the line search failed along the steepest descent, stopping at iteration " << iter << std::endl;
+                        break;
+                    }
+                    // restart from the steepest descent
+                    size = 0;
+                    ++n_skipped;
+                    continue;
+                }
+
+                // new pair, stored only with positive curvature, over the oldest one if full
+                const double sy = (x_new - x).dot(g_new - g);
+                if (sy > 1e-12 * (x_new - x).norm() * (g_new - g).norm()) {
+                    const int k = (first + size) % m;
+                    S.col(k) = x_new - x;
+                    Y.col(k) = g_new - g;
+                    rho[k] = 1. / sy;
+                    if (size < m)
+                        ++size;
+                    else
+                        first = (first + 1) % m;
+                } else
+                    ++n_skipped;
+
+                std::swap(x, x_new);
+                std::swap(g, g_new);
+                f_x = f_new;
+                iter++;
+
+                // Output progress
+                if (iter % 100 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g.norm() << std::endl;
+                }
+            }
+
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            if (n_skipped > 0) {
+                std::cout << "Skipped updates: " << n_skipped << std::endl;
+            }
+
+            return x;
+        }
+    };
+}
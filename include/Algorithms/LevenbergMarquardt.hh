@@ -0,0 +1,260 @@
+#pragma once
+
+#include <FunctionBase/LeastSquaresBaseSparse.hh>
+#include <Eigen/SparseCholesky>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    /* Performs the Levenberg-Marquardt method on a nonlinear least-squares problem
+     * f(x) = 1/2 ||r(x)||^2 with the interface of LeastSquaresBaseSparse.
+     *
+     * Each step solves (J^T J + mu D) dx = -J^T r, J^T J being the Gauss-Newton model
+     * of the Hessian, which is always positive semi-definite, and D the largest
+     * diagonal of J^T J seen so far (Marquardt's scaling). The step is accepted if the
+     * ratio rho of the actual and predicted decreases of f is positive, and mu is
+     * updated as in Nielsen's rule, so that the method goes to Gauss-Newton,
+     * with its near-quadratic convergence on nearly consistent problems, when the
+     * model is good and to a short gradient step otherwise. */
+    class LevenbergMarquardt {
+    public:
+        typedef LeastSquaresBaseSparse::Vec Vec;   ///< Eigen::VectorXd
+        typedef LeastSquaresBaseSparse::SMat SMat; ///< Eigen::SparseMatrix<double>
+
+        /* Lower triangle of J^T J + mu D for a Jacobian J of fixed sparsity pattern.
+         * The pattern of J^T J and, for each of its entries, the pairs of entries of J
+         * whose products it sums are computed once, as well as the symbolic factorization,
+         * so that each iteration only refills values and factorizes numerically. */
+        class NormalEquations {
+        public:
+            NormalEquations() : n_analyze_(0) {}
+
+            // updates J^T J from _J, rebuilding the pattern if _J's pattern changed
+            void update(const SMat& _J) {
+                if(!has_pattern(_J))
+                    setup_pattern(_J);
+
+                const double* j_values = _J.valuePtr();
+                double* a_values = A_.valuePtr();
+                for(int p = 0; p < A_.nonZeros(); ++p) {
+                    double sum(0);
+                    for(int q = pair_offsets_[p]; q < pair_offsets_[p + 1]; ++q)
+                        sum += j_values[pairs_[2 * q]] * j_values[pairs_[2 * q + 1]];
+                    a_values[p] = sum;
+                }
+                for(size_t j = 0; j < diag_.size(); ++j)
+                    jtj_diag_[j] = a_values[diag_[j]];
+            }
+
+            // diagonal of J^T J
+            const Vec& diagonal() const { return jtj_diag_; }
+
+            /** factorizes J^T J + mu * diag(_d)
+             * \return false if the factorization failed */
+            bool factorize(const double _mu, const Vec& _d) {
+                double* a_values = A_.valuePtr();
+                for(size_t j = 0; j < diag_.size(); ++j)
+                    a_values[diag_[j]] = jtj_diag_[j] + _mu * _d[j];
+
+                ldlt_.factorize(A_);
+                return ldlt_.info() == Eigen::Success && ldlt_.vectorD().minCoeff() > 0.;
+            }
+
+            void solve(const Vec& _b, Vec& _x) const {
+                _x = ldlt_.solve(_b);
+            }
+
+            // number of symbolic factorizations so far
+            int n_analyze() const { return n_analyze_; }
+
+        private:
+            bool has_pattern(const SMat& _J) const {
+                return _J.isCompressed() && _J.cols() == A_.cols() && _J.rows() == j_rows_
+                       && size_t(_J.nonZeros()) == j_inner_.size()
+                       && std::equal(_J.outerIndexPtr(), _J.outerIndexPtr() + _J.outerSize() + 1, j_outer_.begin())
+                       && std::equal(_J.innerIndexPtr(), _J.innerIndexPtr() + _J.nonZeros(), j_inner_.begin());
+            }
+
+            void setup_pattern(const SMat& _J) {
+                j_rows_ = _J.rows();
+                j_outer_.assign(_J.outerIndexPtr(), _J.outerIndexPtr() + _J.outerSize() + 1);
+                j_inner_.assign(_J.innerIndexPtr(), _J.innerIndexPtr() + _J.nonZeros());
+
+                // (J^T J)(i, j) = sum over the rows r of J(r, i) * J(r, j), i.e. the pairs of
+                // entries of the columns i and j in the same row. Rows are gathered from the
+                // columns of J, each row knowing the positions of its entries in J
+                const int n = _J.cols();
+                std::vector<std::vector<std::pair<int, int>>> rows(_J.rows()); // (column, position)
+                for(int j = 0; j < n; ++j)
+                    for(int p = j_outer_[j]; p < j_outer_[j + 1]; ++p)
+                        rows[j_inner_[p]].emplace_back(j, p);
+
+                // lower triangle, column by column, with the diagonal always present
+                std::vector<std::vector<std::pair<int, std::pair<int, int>>>> cols(n); // (row, (pos_i, pos_j))
+                for(const auto& row : rows)
+                    for(const auto& e0 : row)
+                        for(const auto& e1 : row)
+                            if(e0.first >= e1.first)
+                                cols[e1.first].emplace_back(e0.first, std::make_pair(e0.second, e1.second));
+
+                std::vector<int> outer(n + 1, 0), inner;
+                pairs_.clear();
+                pair_offsets_.assign(1, 0);
+                diag_.resize(n);
+                for(int j = 0; j < n; ++j) {
+                    auto& c = cols[j];
+                    c.emplace_back(j, std::make_pair(-1, -1));
+                    std::sort(c.begin(), c.end());
+                    for(size_t k = 0; k < c.size(); ++k) {
+                        if(k == 0 || c[k].first != c[k - 1].first) {
+                            if(c[k].first == j)
+                                diag_[j] = static_cast<int>(inner.size());
+                            inner.push_back(c[k].first);
+                            pair_offsets_.push_back(pair_offsets_.back());
+                        }
+                        if(c[k].second.first >= 0) {
+                            pairs_.push_back(c[k].second.first);
+                            pairs_.push_back(c[k].second.second);
+                            ++pair_offsets_.back();
+                        }
+                    }
+                    outer[j + 1] = static_cast<int>(inner.size());
+                }
+
+                A_.resize(n, n);
+                A_.resizeNonZeros(static_cast<int>(inner.size()));
+                std::copy(outer.begin(), outer.end(), A_.outerIndexPtr());
+                std::copy(inner.begin(), inner.end(), A_.innerIndexPtr());
+                std::fill(A_.valuePtr(), A_.valuePtr() + inner.size(), 0.);
+                jtj_diag_.resize(n);
+
+                ldlt_.analyzePattern(A_);
+                ++n_analyze_;
+            }
+
+        private:
+            // lower triangle of J^T J + mu D, and its factorization
+            SMat A_;
+            Eigen::SimplicialLDLT<SMat, Eigen::Lower> ldlt_;
+
+            // for the p-th entry of A_, the positions in J of the factors of its products
+            // are pairs_[2q], pairs_[2q + 1] for pair_offsets_[p] <= q < pair_offsets_[p + 1]
+            std::vector<int> pairs_;
+            std::vector<int> pair_offsets_;
+            // position of the diagonal in A_, and the diagonal of J^T J
+            std::vector<int> diag_;
+            Vec jtj_diag_;
+
+            // pattern of the last J
+            long j_rows_ = -1;
+            std::vector<int> j_outer_;
+            std::vector<int> j_inner_;
+
+            int n_analyze_;
+        };
+
+
+        /**
+         * \param _problem a pointer to a least-squares problem, which can be any type that
+         *        has the same interface as LeastSquaresBaseSparse's (i.e. with eval_residual,
+         *        eval_jacobian) and an n_unknowns() function
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient J^T r norm
+         * \param _max_iters a capping number of iterations
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4, const int _max_iters = 1000) {
+            std::cout << "******** Levenberg-Marquardt ********" << std::endl;
+
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            // get starting point
+            Vec x = _initial_x;
+
+            const int n = _problem->n_unknowns();
+            Vec r, r_new, g(n), dx(n), x_new(n), d = Vec::Zero(n);
+            SMat J;
+            NormalEquations normal_equations;
+            int iter(0), n_rejected(0);
+
+            _problem->eval_residual(x, r);
+            double f_x = 0.5 * r.squaredNorm();
+            double mu(1e-3), nu(2.);
+            bool update_jacobian = true;
+
+            while (iter < _max_iters) {
+                if (update_jacobian) {
+                    _problem->eval_jacobian(x, J);
+                    normal_equations.update(J);
+                    g.noalias() = J.transpose() * r;
+                    // Marquardt's scaling, kept positive for the nodes without residuals
+                    d = d.cwiseMax(normal_equations.diagonal()).cwiseMax(1e-12);
+                    update_jacobian = false;
+                }
+
+                if (g.squaredNorm() < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g.squaredNorm() << std::endl;
+                    break;
+                }
+
+                if (!normal_equations.factorize(mu, d)) {
+                    mu *= nu;
+                    nu *= 2.;
+                    if (mu > 1e300) {
+                        std::cout << "Warning: the damped normal equations could not be factorized, stopping at iteration " << iter << std::endl;
+                        break;
+                    }
+                    continue;
+                }
+                normal_equations.solve(g, dx);
+                dx *= -1.;
+
+                x_new = x + dx;
+                _problem->eval_residual(x_new, r_new);
+                const double f_new = 0.5 * r_new.squaredNorm();
+
+                // decrease predicted by the model, 1/2 dx^T (mu D dx - g)
+                const double predicted = 0.5 * (mu * dx.dot(d.cwiseProduct(dx)) - g.dot(dx));
+                const double rho = (f_x - f_new) / predicted;
+
+                if (predicted > 0. && rho > 0.) {
+                    std::swap(x, x_new);
+                    std::swap(r, r_new);
+                    f_x = f_new;
+                    mu *= std::max(1. / 3., 1. - std::pow(2. * rho - 1., 3));
+                    nu = 2.;
+                    update_jacobian = true;
+                    iter++;
+
+                    if (iter % 10 == 0) {
+                        std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g.norm()
+                                  << " | mu = " << mu << std::endl;
+                    }
+                } else {
+                    ++n_rejected;
+                    mu *= nu;
+                    nu *= 2.;
+                    if (mu > 1e300) {
+                        std::cout << "Warning: no decrease found, stopping at iteration " << iter << std::endl;
+                        break;
+                    }
+                }
+            }
+
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            std::cout << "Iterations: " << iter << " | rejected steps: " << n_rejected << std::endl;
+
+            return x;
+        }
+    };
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <FunctionBase/FunctionBaseSparse.hh>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
 
 //== NAMESPACES ===============================================================
 
@@ -31,27 +36,86 @@ namespace AOPT {
                                                const double _t0,
                                                const double _alpha = 0.5,
                                                const double _tau = 0.75) {
-            
-            // Initialize step size
-            double t = _t0;
-
             // Evaluate the function at the starting point
             double f_x = _problem->eval_f(_x);
 
+            return backtracking_line_search(_problem, _x, f_x, _g, _dx, _t0, _alpha, _tau);
+        }
+
+        /** Back-tracking line search method for callers which already know f(_x),
+         * e.g. from eval_f_and_gradient, which saves one function evaluation.
+         * With _fx the value of a NonmonotoneReference instead of f(_x), this is the
+         * nonmonotone line search of Grippo-Lampariello-Lucidi or of Zhang-Hager.
+         *
+         * \param _fx the function value at _x
+         * see above for the other parameters
+         * \return the final step t computed by the back-tracking line search */
+        template <class Problem>
+        static double backtracking_line_search(Problem *_problem,
+                                               const Vec &_x,
+                                               const double _fx,
+                                               const Vec &_g,
+                                               const Vec &_dx,
+                                               const double _t0,
+                                               const double _alpha = 0.5,
+                                               const double _tau = 0.75) {
+            Vec x_new;  // To store the updated x value
+            return backtracking_line_search(_problem, _x, _fx, _g, _dx, _t0, x_new, _alpha, _tau);
+        }
+
+        /** Same as above, with the storage for the trial points provided by the caller.
+         * Iterative solvers keep it across iterations so that no memory is allocated
+         * once it has the problem's size.
+         *
+         * \param _x_new storage for the trial points, resized if needed */
+        template <class Problem>
+        static double backtracking_line_search(Problem *_problem,
+                                               const Vec &_x,
+                                               const double _fx,
+                                               const Vec &_g,
+                                               const Vec &_dx,
+                                               const double _t0,
+                                               Vec &_x_new,
+                                               const double _alpha = 0.5,
+                                               const double _tau = 0.75) {
+            return backtracking_line_search(_problem, _x, _fx, _g, _dx, _t0, _x_new, nullptr, _alpha, _tau);
+        }
+
+        /** Same as above, also giving the function value at the accepted point, so that
+         * solvers continuing from it only need to evaluate the gradient there.
+         *
+         * \param _x_new output, the accepted point x + t dx
+         * \param _f_new output, the function value at _x_new, ignored if nullptr */
+        template <class Problem>
+        static double backtracking_line_search(Problem *_problem,
+                                               const Vec &_x,
+                                               const double _fx,
+                                               const Vec &_g,
+                                               const Vec &_dx,
+                                               const double _t0,
+                                               Vec &_x_new,
+                                               double *_f_new,
+                                               const double _alpha = 0.5,
+                                               const double _tau = 0.75) {
+
+            // Initialize step size
+            double t = _t0;
+
             // Compute the directional derivative (inner product of gradient and direction)
             double grad_dot_dx = _g.dot(_dx);
 
             // Backtracking loop
-            Vec x_new;  // To store the updated x value
             while (true) {
                 // Compute x_new = x + t * dx
-                x_new = _x + t * _dx;
+                _x_new = _x + t * _dx;
 
                 // Evaluate the function at the new point
-                double f_x_new = _problem->eval_f(x_new);
+                double f_x_new = _problem->eval_f(_x_new);
 
                 // Check the Armijo condition
-                if (f_x_new <= f_x + _alpha * t * grad_dot_dx) {
+                if (f_x_new <= _fx + _alpha * t * grad_dot_dx) {
+                    if (_f_new != nullptr)
+                        *_f_new = f_x_new;
                     break; // Condition met, exit the loop
                 }
 
@@ -62,8 +126,327 @@ namespace AOPT {
             return t; // Return the final step size
         }
 
+        /** Storage of speculative_line_search: the trial points, steps and function values
+         * of a round, one per thread, kept by iterative solvers so that no memory is
+         * allocated per line search. */
+        struct SpeculativeTrials {
+            SpeculativeTrials(const int _n_threads = 1, const int _n_unknowns = 0) :
+                    x(std::max(1, _n_threads), Vec(_n_unknowns)),
+                    t(std::max(1, _n_threads)),
+                    f(std::max(1, _n_threads)) {}
+
+            std::vector<Vec> x;
+            std::vector<double> t, f;
+        };
+
+        /** Back-tracking line search with the trial steps evaluated speculatively on
+         * _n_threads threads: each round evaluates the next _n_threads steps of the ladder
+         * t0, tau t0, tau^2 t0, ... at once with eval_f_concurrent, each thread on its own
+         * trial point, and the largest step satisfying the Armijo condition is taken.
+         * This is the step of backtracking_line_search, found in the time of one function
+         * evaluation when one of the first _n_threads steps is accepted, at the cost of
+         * evaluating the smaller steps for nothing.
+         * Without OpenMP, with one thread or for problems without a concurrent eval_f
+         * (see has_concurrent_eval_f), it is backtracking_line_search.
+         *
+         * \param _trials storage of the trial points, steps and function values, resized to
+         *        _n_threads if needed. On return, _trials.x[0] is x + t dx
+         * \param _n_threads the number of threads, i.e. of steps evaluated at once
+         * see backtracking_line_search for the other parameters
+         * \return the final step t */
+        template <class Problem>
+        static double speculative_line_search(Problem *_problem,
+                                              const Vec &_x,
+                                              const double _fx,
+                                              const Vec &_g,
+                                              const Vec &_dx,
+                                              const double _t0,
+                                              SpeculativeTrials &_trials,
+                                              const int _n_threads,
+                                              const double _alpha = 0.5,
+                                              const double _tau = 0.75) {
+            const int n_threads = std::max(1, _n_threads);
+            if(int(_trials.x.size()) < n_threads)
+                _trials = SpeculativeTrials(n_threads, _x.size());
+            if(n_threads == 1 || !_problem->has_concurrent_eval_f())
+                return backtracking_line_search(_problem, _x, _fx, _g, _dx, _t0, _trials.x[0], _alpha, _tau);
+
+            _problem->reserve_concurrent_eval_f(n_threads);
+            const double grad_dot_dx = _g.dot(_dx);
+            // the steps of a round, computed as the sequential backtracking's
+            std::vector<double> &t = _trials.t, &f = _trials.f;
+            std::vector<Vec> &x_trials = _trials.x;
+            double t_next = _t0;
+
+            while (true) {
+                for(int k = 0; k < n_threads; ++k) {
+                    t[k] = t_next;
+                    t_next *= _tau;
+                }
+
+#pragma omp parallel for num_threads(n_threads) schedule(static)
+                for(int k = 0; k < n_threads; ++k) {
+                    x_trials[k] = _x + t[k] * _dx;
+                    f[k] = _problem->eval_f_concurrent(x_trials[k], k);
+                }
+
+                for(int k = 0; k < n_threads; ++k)
+                    if (f[k] <= _fx + _alpha * t[k] * grad_dot_dx) {
+                        std::swap(x_trials[0], x_trials[k]);
+                        return t[k];
+                    }
+            }
+        }
+
+        /** Reference value of the nonmonotone Armijo condition
+         *   f(x + t dx) <= f_ref + alpha t g^T dx,
+         * which lets f increase for a few iterations, so that the steps are not shortened
+         * in narrow curved valleys where a monotone decrease needs tiny steps.
+         * - MAX (Grippo, Lampariello and Lucidi): f_ref is the maximum of the last _memory
+         *   function values, kept in a ring buffer
+         * - AVERAGE (Zhang and Hager): f_ref is the average of all the function values
+         *   with weights eta^age, updated as C = (eta Q C + f) / Q with Q = eta Q + 1,
+         *   and never smaller than the last f, so that the condition can be satisfied.
+         *   eta = 0 gives the monotone condition, eta = 1 the mean of the values
+         * With _memory = 1, MAX is the monotone Armijo condition.
+         * The reference is owned by the iterative solver, which pushes f(x_k) after
+         * each step. */
+        class NonmonotoneReference {
+        public:
+            enum Type {
+                MAX,    ///< maximum of the last values
+                AVERAGE ///< weighted average of the values
+            };
+
+            NonmonotoneReference(const int _memory = 10, const Type _type = MAX, const double _eta = 0.85) :
+                    f_history_(std::max(_memory, 1)), type_(_type), eta_(_eta) {}
+
+            // restarts with the function value at the initial point
+            void reset(const double _f) {
+                std::fill(f_history_.begin(), f_history_.end(), _f);
+                next_ = 0;
+                c_ = _f;
+                q_ = 1.;
+            }
+
+            // records the function value at the new iterate
+            void push(const double _f) {
+                f_history_[next_] = _f;
+                next_ = (next_ + 1) % f_history_.size();
+                q_ = eta_ * q_ + 1.;
+                c_ = std::max(c_ + (_f - c_) / q_, _f);
+            }
+
+            double value() const {
+                return type_ == MAX ? *std::max_element(f_history_.begin(), f_history_.end()) : c_;
+            }
+
+        private:
+            std::vector<double> f_history_;
+            size_t next_ = 0;
+            Type type_;
+            double eta_;
+            // Zhang-Hager average and its normalization
+            double c_ = 0., q_ = 1.;
+        };
+
+        /** Line search for a step t satisfying the strong Wolfe conditions
+         *   f(x + t dx) <= f(x) + c1 t g^T dx   (sufficient decrease)
+         *   |g(x + t dx)^T dx| <= c2 |g^T dx|   (curvature)
+         * The curvature condition is what quasi-Newton methods need to keep positive
+         * definite updates (s^T y > 0), and with a small c2 it makes the steps close
+         * to exact as the conjugate gradient methods need.
+         *
+         * Each trial point is evaluated with eval_f_and_gradient, so that the line search
+         * knows f and its slope g^T dx at both ends of the interval it works on.
+         * Too short steps are extrapolated until a step is too long (no sufficient decrease,
+         * a higher f than the previous step, or a positive slope), which brackets an
+         * acceptable step. The bracket is then shrunk (zoom) with the minimizer of the cubic
+         * interpolating f and the slopes at its ends, safeguarded by bisection when it is not
+         * in the middle 80% of the bracket, as in the methods of More-Thuente and of
+         * Nocedal-Wright (algorithms 3.5 and 3.6). With a good initial step, e.g. 1 for the
+         * quasi-Newton directions, the first trial point is mostly accepted, and otherwise
+         * one or two interpolations typically suffice.
+         *
+         * \param _fx the function value at _x
+         * \param _g gradient at _x, _dx should be a descent direction (_g^T _dx < 0)
+         * \param _x_new, _g_new, _f_new on return, the point x + t dx, its gradient and
+         *        function value, evaluated together with eval_f_and_gradient
+         * \param _c1, _c2 constants of the Wolfe conditions, 0 < c1 < c2 < 1
+         * \param _max_evals maximal number of trial points
+         * \return the step t. If no trial point satisfied both conditions, the one with
+         * sufficient decrease and the lowest f, or 0 (with _x_new = _x) if there was none */
+        template <class Problem>
+        static double wolfe_line_search(Problem *_problem,
+                                        const Vec &_x,
+                                        const double _fx,
+                                        const Vec &_g,
+                                        const Vec &_dx,
+                                        const double _t0,
+                                        Vec &_x_new,
+                                        Vec &_g_new,
+                                        double &_f_new,
+                                        const double _c1 = 1e-4,
+                                        const double _c2 = 0.9,
+                                        const int _max_evals = 40) {
+            const double grad_dot_dx = _g.dot(_dx);
+            // some problems expect a gradient of the right size
+            _g_new.resize(_x.size());
+
+            // t_lo is the step with sufficient decrease and the lowest f so far (0 at first),
+            // t_hi the other end of the bracket, once a step was too long
+            double t_lo(0), f_lo(_fx), slope_lo(grad_dot_dx);
+            double t_hi(0), f_hi(0), slope_hi(0);
+            bool bracketed(false), at_t_lo(false);
+            double t = _t0;
+
+            for(int i = 0; i < _max_evals; ++i) {
+                _x_new = _x + t * _dx;
+                _f_new = _problem->eval_f_and_gradient(_x_new, _g_new);
+                const double slope = _g_new.dot(_dx);
+                at_t_lo = false;
+
+                if(!(_f_new <= _fx + _c1 * t * grad_dot_dx) || _f_new >= f_lo) {
+                    t_hi = t;
+                    f_hi = _f_new;
+                    slope_hi = slope;
+                    bracketed = true;
+                } else if(std::abs(slope) <= -_c2 * grad_dot_dx) {
+                    return t;
+                } else {
+                    // f increases from t towards t_hi, or beyond t before a bracket: t_lo
+                    // becomes the other end
+                    if(slope * (bracketed ? t_hi - t_lo : 1.) >= 0.) {
+                        t_hi = t_lo;
+                        f_hi = f_lo;
+                        slope_hi = slope_lo;
+                        bracketed = true;
+                    }
+                    const double t_prev = t_lo, f_prev = f_lo, slope_prev = slope_lo;
+                    t_lo = t;
+                    f_lo = _f_new;
+                    slope_lo = slope;
+                    at_t_lo = true;
+
+                    if(!bracketed) {
+                        // extrapolation, within [t + 1.1 (t - t_prev), t + 4 (t - t_prev)]
+                        const double t_min = t + 1.1 * (t - t_prev), t_max = t + 4. * (t - t_prev);
+                        const double t_cubic = cubic_minimizer(t_prev, f_prev, slope_prev, t, _f_new, slope);
+                        t = std::isfinite(t_cubic) ? std::min(std::max(t_cubic, t_min), t_max) : t_max;
+                        continue;
+                    }
+                }
+
+                const double width = std::abs(t_hi - t_lo);
+                if(width <= 1e-12 * std::max(t_lo, t_hi))
+                    break;
+                t = cubic_minimizer(t_lo, f_lo, slope_lo, t_hi, f_hi, slope_hi);
+                if(!(std::abs(t - t_lo) > 0.1 * width && std::abs(t - t_hi) > 0.1 * width))
+                    t = 0.5 * (t_lo + t_hi);
+            }
+
+            // fall back to the best step with sufficient decrease
+            if(t_lo > 0.) {
+                if(!at_t_lo) {
+                    _x_new = _x + t_lo * _dx;
+                    _f_new = _problem->eval_f_and_gradient(_x_new, _g_new);
+                }
+            } else {
+                _x_new = _x;
+                _g_new = _g;
+                _f_new = _fx;
+            }
+
+            return t_lo;
+        }
+
+        /** Exact line search for the problems whose function along a line is a polynomial
+         * of degree at most 4 (see FunctionBaseSparse::line_polynomial), such as the mass
+         * spring problems. The coefficients are accumulated in one pass over the problem,
+         * and the step is the minimizer of the polynomial over t > 0, so no trial point
+         * is evaluated.
+         *
+         * \param _x starting point of the method
+         * \param _dx the search direction
+         * \param _p storage for the coefficients, resized if needed
+         * \return the step t, or 0 if the problem is not a polynomial along the line or
+         * decreases nowhere along it, in which case another line search should be used */
+        template <class Problem>
+        static double exact_line_search(Problem *_problem,
+                                        const Vec &_x,
+                                        const Vec &_dx,
+                                        Vec &_p) {
+            if(!_problem->line_polynomial(_x, _dx, _p))
+                return 0.;
+            return minimize_quartic(_p);
+        }
+
+        /** minimizer over t > 0 of p(t) = _p[0] + _p[1] t + ... + _p[4] t^4, i.e. the root of
+         * the cubic p'(t) with p'' > 0 and the lowest p, the roots being computed in closed
+         * form (Cardano, or Viete's trigonometric form for three real roots) and polished
+         * by two Newton iterations
+         * \return 0 if p has no local minimum at t > 0 below p(0) */
+        static double minimize_quartic(const Vec &_p) {
+            // p'(t) = a t^3 + b t^2 + c t + d
+            const double a = 4. * _p[4], b = 3. * _p[3], c = 2. * _p[2], d = _p[1];
+            const double scale = std::abs(b) + std::abs(c) + std::abs(d);
+
+            double roots[3];
+            int n_roots(0);
+            if(std::abs(a) > 1e-14 * scale) {
+                // t = y - B / 3 gives y^3 + P y + Q = 0
+                const double B = b / a, C = c / a, D = d / a;
+                const double P = C - B * B / 3., Q = 2. * B * B * B / 27. - B * C / 3. + D;
+                const double discriminant = 0.25 * Q * Q + P * P * P / 27.;
+                if(discriminant >= 0.) {
+                    const double sd = std::sqrt(discriminant);
+                    roots[n_roots++] = std::cbrt(-0.5 * Q + sd) + std::cbrt(-0.5 * Q - sd) - B / 3.;
+                } else {
+                    const double r = 2. * std::sqrt(-P / 3.);
+                    const double phi = std::acos(std::min(1., std::max(-1., 3. * Q / (P * r))));
+                    for(int k = 0; k < 3; ++k)
+                        roots[n_roots++] = r * std::cos((phi - 2. * std::acos(-1.) * k) / 3.) - B / 3.;
+                }
+            } else if(std::abs(b) > 1e-14 * scale) {
+                const double discriminant = c * c - 4. * b * d;
+                if(discriminant >= 0.) {
+                    const double sd = std::sqrt(discriminant);
+                    roots[n_roots++] = (-c + sd) / (2. * b);
+                    roots[n_roots++] = (-c - sd) / (2. * b);
+                }
+            } else if(c != 0.) {
+                roots[n_roots++] = -d / c;
+            }
+
+            auto p = [&](const double _t) { return (((_p[4] * _t + _p[3]) * _t + _p[2]) * _t + _p[1]) * _t + _p[0]; };
+            double t_min(0), p_min(_p[0]);
+            for(int i = 0; i < n_roots; ++i) {
+                double t = roots[i];
+                auto dp2 = [&](const double _t) { return (3. * a * _t + 2. * b) * _t + c; };
+                for(int k = 0; k < 2; ++k)
+                    if(dp2(t) != 0.)
+                        t -= (((a * t + b) * t + c) * t + d) / dp2(t);
+                if(t > 0. && dp2(t) > 0. && p(t) < p_min) {
+                    t_min = t;
+                    p_min = p(t);
+                }
+            }
+
+            return t_min;
+        }
+
     private:
-        
+        /** minimizer of the cubic interpolating the values _fa, _fb and the slopes _da, _db
+         * at _a and _b, or NaN if the cubic has no local minimum */
+        static double cubic_minimizer(const double _a, const double _fa, const double _da,
+                                      const double _b, const double _fb, const double _db) {
+            const double d1 = _da + _db - 3. * (_fa - _fb) / (_a - _b);
+            const double discriminant = d1 * d1 - _da * _db;
+            if(!(discriminant >= 0.))
+                return std::numeric_limits<double>::quiet_NaN();
+            const double d2 = (_b > _a ? 1. : -1.) * std::sqrt(discriminant);
+            return _b - (_b - _a) * (_db + d2 - d1) / (_db - _da + 2. * d2);
+        }
     };
     //=============================================================================
 }
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <FunctionBase/FunctionBaseSparse.hh>
+#include "LineSearch.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    /* Performs the truncated Newton (Newton-CG) method on a given problem.
+     * The Newton system H dx = -g is solved approximately by the conjugate gradient
+     * method, which only needs Hessian-vector products (eval_hessian_vector, matrix-free
+     * for the mass-spring problems), so the memory stays a few vectors as for the
+     * gradient descent.
+     *
+     * CG stops when ||H dx + g|| <= eta ||g||, with the forcing term eta of
+     * Eisenstat and Walker (choice 2): eta_k = 0.9 (||g_k|| / ||g_{k-1}||)^2, safeguarded
+     * to not drop faster than 0.9 eta_{k-1}^2 and bounded by 0.5. Far from the minimum,
+     * the solves are rough and cheap, and close to it, they become accurate, which gives
+     * superlinear convergence.
+     * CG also stops along a direction of negative (or zero) curvature, in which case
+     * the current iterate is used, or the steepest descent at the first CG iteration,
+     * so that dx is always a descent direction.
+     * Close to the minimum, the decrease along dx falls below the rounding error of the
+     * energy, which the Armijo condition of the line search cannot see anymore, so the
+     * step is then taken in full, the gradient still decreasing. */
+    class NewtonCG {
+    public:
+        typedef FunctionBaseSparse::Vec Vec; ///< Eigen::VectorXd
+
+        // relative decrease of the energy below which its rounding error dominates
+        static constexpr double rounding_tolerance = 1e-14;
+
+        /**
+         * \param _problem a pointer to a specific Problem, which can be any type that
+         *        has the same interface as FunctionBaseSparse's, with eval_hessian_vector
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient norm
+         * \param _max_iters a capping number of Newton iterations
+         * \param _max_cg_iters a capping number of CG iterations per Newton step, 0 for the number of unknowns
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4,
+                         const int _max_iters = 1000, const int _max_cg_iters = 0) {
+            std::cout << "******** Newton-CG ********" << std::endl;
+
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            const int n = _problem->n_unknowns();
+            const int max_cg_iters = _max_cg_iters > 0 ? _max_cg_iters : n;
+
+            // get starting point
+            Vec x = _initial_x;
+
+            // gradient, Newton step and the CG vectors: residual, direction and its product with H
+            Vec g(n), dx(n), x_new(n), r(n), d(n), hd(n);
+            int iter(0), n_cg(0), n_negative_curvature(0);
+            double f_x(0), g_norm_prev(0), eta(0.5);
+
+            while (iter < _max_iters) {
+                f_x = _problem->eval_f_and_gradient(x, g);
+
+                const double g_norm = std::sqrt(g.squaredNorm());
+                if (g_norm * g_norm < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g.squaredNorm() << std::endl;
+                    break;
+                }
+
+                // Eisenstat-Walker forcing term
+                if (iter > 0) {
+                    const double ratio = g_norm / g_norm_prev;
+                    const double eta_safeguard = 0.9 * eta * eta;
+                    eta = 0.9 * ratio * ratio;
+                    if (eta_safeguard > 0.1)
+                        eta = std::max(eta, eta_safeguard);
+                    eta = std::min(eta, 0.5);
+                }
+                g_norm_prev = g_norm;
+
+                // CG on H dx = -g from dx = 0
+                dx.setZero();
+                r = -g;
+                d = r;
+                double rr = r.squaredNorm();
+                const double tolerance2 = eta * eta * rr;
+                for (int j = 0; j < max_cg_iters; ++j) {
+                    _problem->eval_hessian_vector(x, d, hd);
+                    ++n_cg;
+
+                    const double dhd = d.dot(hd);
+                    if (dhd <= 0.) {
+                        // negative curvature, go along the steepest descent if dx is still 0
+                        if (j == 0)
+                            dx = d;
+                        ++n_negative_curvature;
+                        break;
+                    }
+
+                    const double alpha = rr / dhd;
+                    dx += alpha * d;
+                    r -= alpha * hd;
+
+                    const double rr_new = r.squaredNorm();
+                    if (rr_new <= tolerance2)
+                        break;
+
+                    d = r + (rr_new / rr) * d;
+                    rr = rr_new;
+                }
+
+                // the full Newton step is tried first, and taken as is if the energy
+                // cannot resolve the decrease along dx
+                double t = 1.0;
+                if (-g.dot(dx) > rounding_tolerance * std::abs(f_x))
+                    t = LineSearch::backtracking_line_search(_problem, x, f_x, g, dx, 1.0, x_new);
+
+                x += t * dx;
+                iter++;
+
+                if (iter % 10 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g_norm
+                              << " | eta = " << eta << std::endl;
+                }
+            }
+
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            std::cout << "Iterations: " << iter << " | CG iterations: " << n_cg
+                      << " | negative curvature exits: " << n_negative_curvature << std::endl;
+
+            return x;
+        }
+    };
+}
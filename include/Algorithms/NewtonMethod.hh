@@ -0,0 +1,225 @@
+#pragma once
+
+#include <FunctionBase/FunctionBaseSparse.hh>
+#include "LineSearch.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    /* Performs Newton's method on a problem with a sparse Hessian, i.e. a
+     * FunctionBaseSparse-style interface.
+     * Each step solves H dx = -g with a sparse LDLT factorization of the Hessian,
+     * regularized as H + delta * I whenever H is not positive definite, and then
+     * uses the back-tracking line search along dx starting from the full step. */
+    class NewtonMethod {
+    public:
+        typedef FunctionBaseSparse::Vec Vec;   ///< Eigen::VectorXd
+        typedef FunctionBaseSparse::SMat SMat; ///< Eigen::SparseMatrix<double>
+        typedef FunctionBaseSparse::T T;
+
+        /* Sparse LDLT factorization of H + delta * I, delta >= 0 being the smallest
+         * value of the sequence 0, delta_min, 10 delta_min, ... for which all the
+         * pivots are positive. The next factorization starts from delta / 10,
+         * since consecutive Hessians are usually alike.
+         *
+         * The symbolic factorization (analyzePattern) only depends on the sparsity
+         * pattern, so it is only done when the pattern of H changes, e.g. once for all
+         * the iterations on a given problem. The pattern of H + delta * I is kept with
+         * the position of each entry of H and of each diagonal entry in it, so that
+         * only its values are refilled before each numerical factorization. */
+        class RegularizedLDLT {
+        public:
+            RegularizedLDLT() : delta_(0.), n_analyze_(0) {}
+
+            /** factorizes _H + delta * I, see above
+             * \return false if no tried delta gave positive pivots */
+            bool compute(const SMat& _H) {
+                // the entries are addressed by their position in the values
+                if(!_H.isCompressed()) {
+                    H_compressed_ = _H;
+                    H_compressed_.makeCompressed();
+                    return compute(H_compressed_);
+                }
+
+                if(!has_pattern(_H))
+                    setup_pattern(_H);
+
+                // scale of delta_min, from the diagonal of _H
+                double diag_scale(0);
+                const double* h_values = _H.valuePtr();
+                for(size_t j = 0; j < h_diag_.size(); ++j)
+                    if(h_diag_[j] >= 0)
+                        diag_scale += std::abs(h_values[h_diag_[j]]);
+                diag_scale = std::max(1., diag_scale / double(std::max<size_t>(1, h_diag_.size())));
+                const double delta_min = 1e-8 * diag_scale;
+
+                double delta = delta_ * 0.1 >= delta_min ? delta_ * 0.1 : 0.;
+                for(int attempt = 0; attempt < 60; ++attempt) {
+                    double* k_values = K_.valuePtr();
+                    std::fill(k_values, k_values + K_.nonZeros(), 0.);
+                    for(int p = 0; p < _H.nonZeros(); ++p)
+                        k_values[h_to_k_[p]] += h_values[p];
+                    for(int k_slot : k_diag_)
+                        k_values[k_slot] += delta;
+
+                    ldlt_.factorize(K_);
+                    if(ldlt_.info() == Eigen::Success && ldlt_.vectorD().minCoeff() > 0.) {
+                        delta_ = delta;
+                        return true;
+                    }
+
+                    delta = std::max(10. * delta, delta_min);
+                }
+
+                return false;
+            }
+
+            // solves (H + delta * I) _x = _b with the last successful factorization
+            void solve(const Vec& _b, Vec& _x) const {
+                _x = ldlt_.solve(_b);
+            }
+
+            // delta of the last successful factorization
+            double regularization() const { return delta_; }
+
+            // number of symbolic factorizations so far
+            int n_analyze() const { return n_analyze_; }
+
+        private:
+            bool has_pattern(const SMat& _H) const {
+                return _H.rows() == K_.rows() && _H.cols() == K_.cols()
+                       && size_t(_H.nonZeros()) == h_inner_.size()
+                       && std::equal(_H.outerIndexPtr(), _H.outerIndexPtr() + _H.outerSize() + 1, h_outer_.begin())
+                       && std::equal(_H.innerIndexPtr(), _H.innerIndexPtr() + _H.nonZeros(), h_inner_.begin());
+            }
+
+            // builds the pattern of H + I and runs the symbolic factorization
+            void setup_pattern(const SMat& _H) {
+                h_outer_.assign(_H.outerIndexPtr(), _H.outerIndexPtr() + _H.outerSize() + 1);
+                h_inner_.assign(_H.innerIndexPtr(), _H.innerIndexPtr() + _H.nonZeros());
+
+                std::vector<T> triplets;
+                triplets.reserve(_H.nonZeros() + _H.rows());
+                for(int j = 0; j < _H.outerSize(); ++j)
+                    for(SMat::InnerIterator it(_H, j); it; ++it)
+                        triplets.emplace_back(it.row(), it.col(), 0.);
+                for(int i = 0; i < _H.rows(); ++i)
+                    triplets.emplace_back(i, i, 0.);
+
+                K_.resize(_H.rows(), _H.cols());
+                K_.setFromTriplets(triplets.begin(), triplets.end());
+                K_.makeCompressed();
+
+                // position of H's entries and of the diagonal in K_
+                h_to_k_.resize(_H.nonZeros());
+                h_diag_.assign(_H.cols(), -1);
+                for(int j = 0; j < _H.outerSize(); ++j)
+                    for(int p = h_outer_[j]; p < h_outer_[j + 1]; ++p) {
+                        h_to_k_[p] = slot(h_inner_[p], j);
+                        if(h_inner_[p] == j)
+                            h_diag_[j] = p;
+                    }
+                k_diag_.resize(K_.cols());
+                for(int j = 0; j < K_.cols(); ++j)
+                    k_diag_[j] = slot(j, j);
+
+                ldlt_.analyzePattern(K_);
+                ++n_analyze_;
+            }
+
+            // offset of the entry (_row, _col) in K_'s values
+            int slot(const int _row, const int _col) const {
+                const int* begin = K_.innerIndexPtr() + K_.outerIndexPtr()[_col];
+                const int* end = K_.innerIndexPtr() + K_.outerIndexPtr()[_col + 1];
+                return static_cast<int>(std::lower_bound(begin, end, _row) - K_.innerIndexPtr());
+            }
+
+        private:
+            // copy of H if it is given in uncompressed mode
+            SMat H_compressed_;
+
+            // pattern of H + I and its factorization
+            SMat K_;
+            Eigen::SimplicialLDLT<SMat> ldlt_;
+
+            // pattern of the last H, position of its entries in K_ and of its diagonal (-1 if none)
+            std::vector<int> h_outer_;
+            std::vector<int> h_inner_;
+            std::vector<int> h_to_k_;
+            std::vector<int> h_diag_;
+            // position of the diagonal in K_
+            std::vector<int> k_diag_;
+
+            double delta_;
+            int n_analyze_;
+        };
+
+
+        /**
+         * \param _problem a pointer to a specific Problem, which can be any type that
+         *        has the same interface as FunctionBaseSparse's (i.e. with eval_f, eval_gradient, etc.)
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient norm
+         * \param _max_iters a capping number of iterations
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4, const int _max_iters = 1000) {
+            std::cout << "******** Newton Method ********" << std::endl;
+
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            // get starting point
+            Vec x = _initial_x;
+
+            // allocate gradient, Newton step and line search storage
+            const int n = _problem->n_unknowns();
+            Vec g(n), dx(n), x_new(n);
+            SMat H;
+            RegularizedLDLT ldlt;
+            int iter(0);
+            double f_x(0);
+
+            while (iter < _max_iters) {
+                f_x = _problem->eval_f_and_gradient(x, g);
+
+                if (g.squaredNorm() < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g.squaredNorm() << std::endl;
+                    break;
+                }
+
+                // Newton step, (H + delta I) dx = -g
+                _problem->eval_hessian(x, H);
+                if (!ldlt.compute(H)) {
+                    std::cout << "Warning: the regularized Hessian could not be factorized, stopping at iteration " << iter << std::endl;
+                    break;
+                }
+                ldlt.solve(g, dx);
+                dx *= -1.;
+
+                // the full Newton step is tried first
+                double t = LineSearch::backtracking_line_search(_problem, x, f_x, g, dx, 1.0, x_new);
+
+                x += t * dx;
+                iter++;
+
+                if (iter % 10 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g.norm()
+                              << " | regularization = " << ldlt.regularization() << std::endl;
+                }
+            }
+
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+
+            return x;
+        }
+    };
+}
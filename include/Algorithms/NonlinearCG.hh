@@ -0,0 +1,163 @@
+#pragma once
+
+#include <FunctionBase/FunctionBaseSparse.hh>
+#include "LineSearch.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    /* Performs the nonlinear conjugate gradient method on a given problem.
+     * The search directions are d_{k+1} = -g_{k+1} + beta_k d_k, with one of the
+     * formulas below for beta_k (y_k = g_{k+1} - g_k):
+     *  - Polak-Ribiere+ : max(0, g_{k+1}^T y_k / g_k^T g_k)
+     *  - Hestenes-Stiefel : g_{k+1}^T y_k / d_k^T y_k
+     *  - Dai-Yuan : g_{k+1}^T g_{k+1} / d_k^T y_k
+     *
+     * The method restarts with the steepest descent every n iterations (by default
+     * the number of unknowns), when successive gradients lose their orthogonality
+     * (|g_{k+1}^T g_k| >= 0.2 g_{k+1}^T g_{k+1}, Powell's criterion) and whenever
+     * d_{k+1} is not a descent direction.
+     *
+     * Besides x and g, it only needs three work vectors: the direction, and the
+     * trial point and its gradient for the line search.
+     *
+     * The line search is the strong Wolfe one, or, for the problems which are
+     * polynomials along lines such as the mass spring problems, the exact one
+     * (LineSearch::exact_line_search), whose steps make the directions conjugate as
+     * in the linear CG, the Wolfe line search remaining the fallback. */
+    class NonlinearCG {
+    public:
+        typedef FunctionBaseSparse::Vec Vec; ///< Eigen::VectorXd
+
+        enum BetaFormula {POLAK_RIBIERE_PLUS, HESTENES_STIEFEL, DAI_YUAN};
+
+
+        /**
+         * \param _problem a pointer to a specific Problem, which can be any type that
+         *        has the same interface as FunctionBase's (i.e. with eval_f, eval_gradient, etc.)
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient norm
+         * \param _max_iters a capping number of iterations
+         * \param _beta the formula for beta, see above
+         * \param _restart_iters number of iterations between restarts, 0 for the number of unknowns
+         * \param _exact_line_search whether to use the exact line search
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4,
+                         const int _max_iters = 100000, const BetaFormula _beta = POLAK_RIBIERE_PLUS,
+                         const int _restart_iters = 0, const bool _exact_line_search = false) {
+            std::cout << "******** Nonlinear Conjugate Gradient ********" << std::endl;
+
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            const int n = _problem->n_unknowns();
+            const int restart_iters = _restart_iters > 0 ? _restart_iters : n;
+
+            // get starting point
+            Vec x = _initial_x;
+
+            // the work vectors, the iterations do not allocate memory
+            Vec g(n), d(n), x_new(n), g_new(n);
+            // coefficients of the line polynomial of the exact line search
+            Vec p(5);
+            int iter(0), n_restarts(0), since_restart(0), n_fallbacks(0);
+            double f_x = _problem->eval_f_and_gradient(x, g);
+            double f_new(0);
+            // step and g^T d of the previous iteration
+            double t(0), gd_prev(0);
+
+            d = -g;
+
+            while (iter < _max_iters) {
+                if (g.squaredNorm() < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g.squaredNorm() << std::endl;
+                    break;
+                }
+
+                // the initial step assumes the same first-order decrease as in the previous
+                // iteration, t0 g_k^T d_k = t g_{k-1}^T d_{k-1}
+                const double gd = g.dot(d);
+                const double t0 = t > 0. ? std::min(1., t * gd_prev / gd) : std::min(1., 1. / std::sqrt(g.squaredNorm()));
+                t = _exact_line_search ? LineSearch::exact_line_search(_problem, x, d, p) : 0.;
+                if (t > 0.) {
+                    x_new = x + t * d;
+                    f_new = _problem->eval_f_and_gradient(x_new, g_new);
+                    // rounding errors near the minimum
+                    if (!(f_new <= f_x + 1e-4 * t * gd))
+                        t = 0.;
+                }
+                if (t == 0.) {
+                    // a small c2 makes the line search accurate enough for conjugacy
+                    t = LineSearch::wolfe_line_search(_problem, x, f_x, g, d, t0, x_new, g_new, f_new, 1e-4, 0.1);
+                    if (_exact_line_search)
+                        ++n_fallbacks;
+                }
+
+                if (t == 0.) {
+                    if (since_restart == 0) {
+                        std::cout << "Warning: the line search failed along the steepest descent, stopping at iteration " << iter << std::endl;
+                        break;
+                    }
+                    // restart from the steepest descent
+                    d = -g;
+                    since_restart = 0;
+                    ++n_restarts;
+                    continue;
+                }
+
+                // beta from g = g_k, g_new = g_{k+1} and d = d_k
+                const double gg_new = g_new.squaredNorm();
+                const double gy = gg_new - g_new.dot(g);
+                const double dy = d.dot(g_new) - gd;
+                double beta(0);
+                switch (_beta) {
+                    case POLAK_RIBIERE_PLUS: beta = std::max(0., gy / g.squaredNorm()); break;
+                    case HESTENES_STIEFEL: beta = gy / dy; break;
+                    case DAI_YUAN: beta = gg_new / dy; break;
+                }
+
+                bool restart = ++since_restart >= restart_iters
+                               || std::abs(g_new.dot(g)) >= 0.2 * gg_new
+                               || !std::isfinite(beta);
+
+                std::swap(x, x_new);
+                std::swap(g, g_new);
+                f_x = f_new;
+                gd_prev = gd;
+                iter++;
+
+                if (!restart) {
+                    d = beta * d - g;
+                    restart = g.dot(d) >= 0.;
+                }
+                if (restart) {
+                    d = -g;
+                    since_restart = 0;
+                    ++n_restarts;
+                }
+
+                // Output progress
+                if (iter % 1000 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g.norm() << std::endl;
+                }
+            }
+
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            std::cout << "Iterations: " << iter << " | restarts: " << n_restarts;
+            if (_exact_line_search)
+                std::cout << " | Wolfe fallbacks: " << n_fallbacks;
+            std::cout << std::endl;
+
+            return x;
+        }
+    };
+}
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <FunctionBase/FunctionBaseSparse.hh>
+#include <Functions/MassSpringProblem2DSparse.hh>
+#include "LineSearch.hh"
+#include "NewtonMethod.hh"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    /* Overlapping Schwarz domain decomposition for the mass spring problems.
+     *
+     * The nodes are partitioned into subdomains by recursive coordinate bisection of their
+     * positions: a set of nodes is split at the median of its coordinate of largest extent,
+     * into two sets whose sizes are proportional to their numbers of subdomains. Each part is
+     * grown by _overlap layers of spring neighbors into the free nodes of a subdomain, whose
+     * neighbors are its frozen boundary nodes. The sub-problem of a subdomain is made of the
+     * springs and constrained nodes of its free and frozen nodes, so it has all energy terms
+     * of the free nodes: it differs from the full energy by terms of the frozen nodes only,
+     * and decreasing it on the free nodes decreases the full energy.
+     *
+     * Each outer iteration takes a few regularized Newton steps, or gradient steps, on the
+     * free nodes of each subdomain, either
+     * - MULTIPLICATIVE: from the latest positions, i.e. one subdomain after the other, except
+     *   that the subdomains which don't read each other's free nodes (a greedy coloring of
+     *   the subdomains) are solved concurrently, or
+     * - ADDITIVE: all concurrently from the same positions, each node then taking the
+     *   position of the subdomain it was partitioned into (restricted additive Schwarz),
+     *   and the resulting correction being applied with a line search on the full problem.
+     *
+     * The subdomains are solved on n_threads threads with OpenMP, each one keeping its
+     * sub-problem, Hessian, factorization and vectors, so that a thread works on the small
+     * data of one subdomain at a time. */
+    class OverlappingSchwarz {
+    public:
+        typedef FunctionBaseSparse::Vec Vec;   ///< Eigen::VectorXd
+        typedef FunctionBaseSparse::SMat SMat; ///< Eigen::SparseMatrix<double>
+
+        enum Variant {
+            ADDITIVE,
+            MULTIPLICATIVE
+        };
+
+        enum LocalSolver {
+            NEWTON,
+            GRADIENT_DESCENT
+        };
+
+
+        /**
+         * \param _msp the mass spring problem, whose springs and constrained nodes are
+         *        copied into the sub-problems, so it must not be modified afterwards
+         * \param _points the node positions on which the nodes are partitioned, e.g. the
+         *        points of the spring graph at rest
+         * \param _n_subdomains the number of subdomains
+         * \param _overlap the number of layers of neighbors added to each part */
+        OverlappingSchwarz(MassSpringProblem2DSparse& _msp, const Vec& _points, const int _n_subdomains,
+                           const int _overlap = 1) {
+            const int n_nodes = _msp.n_unknowns() / 2;
+            const int n_subdomains = std::max(1, std::min(_n_subdomains, n_nodes));
+
+            // recursive coordinate bisection
+            std::vector<int> nodes(n_nodes);
+            std::iota(nodes.begin(), nodes.end(), 0);
+            part_.resize(n_nodes);
+            bisect(nodes, 0, nodes.size(), n_subdomains, 0, _points);
+
+            // spring neighbors of the nodes, in compressed rows
+            std::vector<int> offsets(n_nodes + 1, 0), neighbors(2 * _msp.n_springs());
+            for(size_t i = 0; i < _msp.n_springs(); ++i) {
+                ++offsets[_msp.spring_nodes(i).first + 1];
+                ++offsets[_msp.spring_nodes(i).second + 1];
+            }
+            for(int v = 0; v < n_nodes; ++v)
+                offsets[v + 1] += offsets[v];
+            std::vector<int> pos(offsets.begin(), offsets.end() - 1);
+            for(size_t i = 0; i < _msp.n_springs(); ++i) {
+                const auto e = _msp.spring_nodes(i);
+                neighbors[pos[e.first]++] = e.second;
+                neighbors[pos[e.second]++] = e.first;
+            }
+
+            // the nodes of each subdomain: its part, the overlap layers and the frozen nodes,
+            // in that order, their local index being their position
+            std::vector<int> local_index(n_nodes, -1);
+            for(int s = 0; s < n_subdomains; ++s) {
+                subdomains_.emplace_back(new Subdomain());
+                Subdomain& sub = *subdomains_.back();
+
+                for(int v = 0; v < n_nodes; ++v)
+                    if(part_[v] == s)
+                        sub.nodes.push_back(v);
+                sub.n_owned = static_cast<int>(sub.nodes.size());
+
+                size_t layer_begin = 0;
+                for(int layer = 0; layer <= _overlap; ++layer) {
+                    if(layer == _overlap)
+                        sub.n_free = static_cast<int>(sub.nodes.size());
+                    for(const int v : sub.nodes)
+                        local_index[v] = 0;
+                    const size_t layer_end = sub.nodes.size();
+                    for(size_t k = layer_begin; k < layer_end; ++k)
+                        for(int j = offsets[sub.nodes[k]]; j < offsets[sub.nodes[k] + 1]; ++j)
+                            if(local_index[neighbors[j]] < 0) {
+                                local_index[neighbors[j]] = 0;
+                                sub.nodes.push_back(neighbors[j]);
+                            }
+                    layer_begin = layer_end;
+                }
+
+                for(size_t k = 0; k < sub.nodes.size(); ++k)
+                    local_index[sub.nodes[k]] = static_cast<int>(k);
+                sub.msp = _msp.make_subproblem(local_index, static_cast<int>(sub.nodes.size()));
+                sub.problem.set_function(sub.msp.get(), 2 * sub.n_free);
+                for(const int v : sub.nodes)
+                    local_index[v] = -1;
+            }
+
+            setup_coloring(n_nodes);
+        }
+
+        ~OverlappingSchwarz() {}
+
+        int n_subdomains() const {
+            return static_cast<int>(subdomains_.size());
+        }
+
+        // the subdomain each node was partitioned into
+        const std::vector<int>& partition() const {
+            return part_;
+        }
+
+        // nodes of a subdomain, the free ones (the part and the overlap) followed by the frozen ones
+        const std::vector<int>& subdomain_nodes(const int _s) const {
+            return subdomains_[_s]->nodes;
+        }
+
+        int n_free_nodes(const int _s) const {
+            return subdomains_[_s]->n_free;
+        }
+
+        // number of groups of subdomains solved concurrently by the multiplicative variant
+        int n_colors() const {
+            return static_cast<int>(color_offsets_.size()) - 1;
+        }
+
+        /** Sets the number of threads solving the subdomains, which requires OpenMP.
+         * 1 (the default) solves them one after the other. */
+        void set_n_threads(const int _n_threads) {
+            n_threads_ = std::max(1, _n_threads);
+        }
+
+        int n_threads() const { return n_threads_; }
+
+        /**
+         * \param _problem a pointer to the full problem, which can be any type that has the
+         *        same interface as FunctionBaseSparse's, e.g. an OptimizationStatistic of the
+         *        MSP, and is used for the stopping criterion and the additive line search
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient norm
+         * \param _max_iters a capping number of outer iterations
+         * \param _variant how the subdomain solutions are combined
+         * \param _local_solver the method of the subdomain steps
+         * \param _n_local_iters the maximal number of steps per subdomain and outer iteration
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4, const int _max_iters = 1000,
+                  const Variant _variant = MULTIPLICATIVE, const LocalSolver _local_solver = NEWTON,
+                  const int _n_local_iters = 5) {
+            std::cout << "******** Overlapping Schwarz ********" << std::endl;
+
+            if(_problem->n_unknowns() != 2 * static_cast<int>(part_.size())) {
+                std::cout << "Warning: the problem does not match the partitioned one, returning the initial point" << std::endl;
+                return _initial_x;
+            }
+
+            // squared epsilon for stopping criterion, the subdomains sharing it
+            double e2 = _eps * _eps;
+            const double local_e2 = e2 / double(subdomains_.size());
+
+            Vec x = _initial_x;
+            Vec g(x.size()), dx(x.size()), x_new(x.size());
+            int iter(0), n_local_steps(0), n_skipped(0);
+            for(auto& sub : subdomains_)
+                sub->step = 1.;
+
+            while (iter < _max_iters) {
+                const double f_x = _problem->eval_f_and_gradient(x, g);
+                if (g.squaredNorm() < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g.squaredNorm() << std::endl;
+                    break;
+                }
+
+                if(_variant == MULTIPLICATIVE) {
+                    // the subdomains of a color only write free nodes that the others don't read
+                    for(int c = 0; c < n_colors(); ++c) {
+#pragma omp parallel for schedule(dynamic) num_threads(n_threads_) if(n_threads_ > 1) reduction(+:n_local_steps)
+                        for(int k = color_offsets_[c]; k < color_offsets_[c + 1]; ++k) {
+                            Subdomain& sub = *subdomains_[colored_subdomains_[k]];
+                            n_local_steps += local_solve(sub, x, _local_solver, _n_local_iters, local_e2);
+                            sub.scatter(sub.n_free, x);
+                        }
+                    }
+                } else {
+                    x_new = x;
+#pragma omp parallel for schedule(dynamic) num_threads(n_threads_) if(n_threads_ > 1) reduction(+:n_local_steps)
+                    for(int s = 0; s < n_subdomains(); ++s) {
+                        Subdomain& sub = *subdomains_[s];
+                        n_local_steps += local_solve(sub, x, _local_solver, _n_local_iters, local_e2);
+                        sub.scatter(sub.n_owned, x_new);
+                    }
+
+                    dx = x_new - x;
+                    if(g.dot(dx) < 0.) {
+                        const double t = LineSearch::backtracking_line_search(_problem, x, f_x, g, dx, 1.0, x_new);
+                        x += t * dx;
+                    } else {
+                        // the combined correction may go uphill where the subdomains disagree
+                        ++n_skipped;
+                    }
+                }
+                iter++;
+
+                if (iter % 10 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g.norm() << std::endl;
+                }
+
+                if(n_skipped > 0 && n_skipped == iter) {
+                    std::cout << "Warning: no additive correction was a descent direction, stopping at iteration " << iter << std::endl;
+                    break;
+                }
+            }
+
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            std::cout << "Iterations: " << iter << " | subdomains: " << subdomains_.size() << " (colors " << n_colors()
+                      << ") | local steps: " << n_local_steps;
+            if(_variant == ADDITIVE)
+                std::cout << " | skipped corrections: " << n_skipped;
+            std::cout << std::endl;
+
+            return x;
+        }
+
+    private:
+        /* The sub-problem of a subdomain as a function of its free nodes, the frozen ones
+         * keeping the positions set in positions() */
+        class FreeNodesProblem : public FunctionBaseSparse {
+        public:
+            FreeNodesProblem() : f_(nullptr), n_(0) {}
+
+            void set_function(FunctionBaseSparse* _f, const int _n_free_unknowns) {
+                f_ = _f;
+                n_ = _n_free_unknowns;
+                x_.setZero(f_->n_unknowns());
+            }
+
+            // all positions of the sub-problem
+            Vec& positions() { return x_; }
+
+            virtual int n_unknowns() override {
+                return n_;
+            }
+
+            virtual double eval_f(const Vec &_x) override {
+                x_.head(n_) = _x;
+                return f_->eval_f(x_);
+            }
+
+            virtual void eval_gradient(const Vec &_x, Vec &_g) override {
+                x_.head(n_) = _x;
+                f_->eval_gradient(x_, g_);
+                _g = g_.head(n_);
+            }
+
+            virtual double eval_f_and_gradient(const Vec &_x, Vec &_g) override {
+                x_.head(n_) = _x;
+                const double f = f_->eval_f_and_gradient(x_, g_);
+                _g = g_.head(n_);
+                return f;
+            }
+
+            virtual void eval_hessian(const Vec &_x, SMat &_h) override {
+                x_.head(n_) = _x;
+                f_->eval_hessian(x_, h_);
+                _h = h_.topLeftCorner(n_, n_);
+            }
+
+        private:
+            FunctionBaseSparse* f_;
+            int n_;
+            Vec x_, g_;
+            SMat h_;
+        };
+
+        struct Subdomain {
+            // writes the positions of its first _n_nodes nodes into _x
+            void scatter(const int _n_nodes, Vec& _x) const {
+                for(int k = 0; k < _n_nodes; ++k) {
+                    _x[2 * nodes[k]] = x[2 * k];
+                    _x[2 * nodes[k] + 1] = x[2 * k + 1];
+                }
+            }
+
+            // the part, the overlap and the frozen nodes
+            std::vector<int> nodes;
+            int n_owned = 0, n_free = 0;
+            std::shared_ptr<MassSpringProblem2DSparse> msp;
+            FreeNodesProblem problem;
+            // free positions and work storage
+            Vec x, g, dx, x_new;
+            SMat H;
+            NewtonMethod::RegularizedLDLT ldlt;
+            double step = 1.;
+        };
+
+        /* steps on the free nodes of _sub from the positions _x
+         * \return the number of steps */
+        static int local_solve(Subdomain& _sub, const Vec& _x, const LocalSolver _local_solver, const int _n_iters,
+                               const double _e2) {
+            Vec& positions = _sub.problem.positions();
+            for(size_t k = 0; k < _sub.nodes.size(); ++k) {
+                positions[2 * k] = _x[2 * _sub.nodes[k]];
+                positions[2 * k + 1] = _x[2 * _sub.nodes[k] + 1];
+            }
+            _sub.x = positions.head(2 * _sub.n_free);
+
+            int n_steps(0);
+            for(; n_steps < _n_iters; ++n_steps) {
+                const double f_x = _sub.problem.eval_f_and_gradient(_sub.x, _sub.g);
+                if(_sub.g.squaredNorm() < _e2)
+                    break;
+
+                if(_local_solver == NEWTON) {
+                    _sub.problem.eval_hessian(_sub.x, _sub.H);
+                    if(!_sub.ldlt.compute(_sub.H))
+                        break;
+                    _sub.ldlt.solve(_sub.g, _sub.dx);
+                    _sub.dx *= -1.;
+                    // the full Newton step is tried first
+                    const double t = LineSearch::backtracking_line_search(&_sub.problem, _sub.x, f_x, _sub.g, _sub.dx,
+                                                                          1.0, _sub.x_new);
+                    _sub.x += t * _sub.dx;
+                } else {
+                    // from twice the previous step length
+                    _sub.dx = -_sub.g;
+                    _sub.step = LineSearch::backtracking_line_search(&_sub.problem, _sub.x, f_x, _sub.g, _sub.dx,
+                                                                     2. * _sub.step, _sub.x_new);
+                    _sub.x += _sub.step * _sub.dx;
+                }
+            }
+
+            return n_steps;
+        }
+
+        // assigns the parts [_first_part, _first_part + _n_parts) to _nodes[_begin, _end)
+        void bisect(std::vector<int>& _nodes, const size_t _begin, const size_t _end, const int _n_parts,
+                    const int _first_part, const Vec& _points) {
+            if(_n_parts == 1) {
+                for(size_t k = _begin; k < _end; ++k)
+                    part_[_nodes[k]] = _first_part;
+                return;
+            }
+
+            // coordinate of largest extent
+            double lo[2] = {_points[2 * _nodes[_begin]], _points[2 * _nodes[_begin] + 1]};
+            double hi[2] = {lo[0], lo[1]};
+            for(size_t k = _begin; k < _end; ++k)
+                for(int c = 0; c < 2; ++c) {
+                    lo[c] = std::min(lo[c], _points[2 * _nodes[k] + c]);
+                    hi[c] = std::max(hi[c], _points[2 * _nodes[k] + c]);
+                }
+            const int c = hi[1] - lo[1] > hi[0] - lo[0] ? 1 : 0;
+
+            const int n_left = _n_parts / 2;
+            const size_t mid = _begin + (_end - _begin) * n_left / _n_parts;
+            std::nth_element(_nodes.begin() + _begin, _nodes.begin() + mid, _nodes.begin() + _end,
+                             [&](const int _a, const int _b) {
+                                 const double pa = _points[2 * _a + c], pb = _points[2 * _b + c];
+                                 return pa < pb || (pa == pb && _a < _b);
+                             });
+
+            bisect(_nodes, _begin, mid, n_left, _first_part, _points);
+            bisect(_nodes, mid, _end, _n_parts - n_left, _first_part + n_left, _points);
+        }
+
+        /* Greedy coloring of the subdomains, two subdomains conflicting when a free node of
+         * one is a node of the other. The subdomains of color c are
+         * colored_subdomains_[color_offsets_[c]], ..., colored_subdomains_[color_offsets_[c+1] - 1]. */
+        void setup_coloring(const int _n_nodes) {
+            // subdomains of each node, with whether it is free in them
+            std::vector<std::vector<std::pair<int, bool>>> memberships(_n_nodes);
+            for(int s = 0; s < n_subdomains(); ++s)
+                for(size_t k = 0; k < subdomains_[s]->nodes.size(); ++k)
+                    memberships[subdomains_[s]->nodes[k]].emplace_back(s, int(k) < subdomains_[s]->n_free);
+
+            std::vector<int> colors(subdomains_.size(), -1);
+            std::vector<bool> used;
+            int n_colors = 0;
+            for(int s = 0; s < n_subdomains(); ++s) {
+                used.assign(subdomains_.size(), false);
+                for(size_t k = 0; k < subdomains_[s]->nodes.size(); ++k) {
+                    const bool free = int(k) < subdomains_[s]->n_free;
+                    for(const auto& m : memberships[subdomains_[s]->nodes[k]])
+                        if(m.first != s && colors[m.first] >= 0 && (free || m.second))
+                            used[colors[m.first]] = true;
+                }
+                int c = 0;
+                while(used[c])
+                    ++c;
+                colors[s] = c;
+                n_colors = std::max(n_colors, c + 1);
+            }
+
+            color_offsets_.assign(n_colors + 1, 0);
+            for(const int c : colors)
+                ++color_offsets_[c + 1];
+            for(int c = 0; c < n_colors; ++c)
+                color_offsets_[c + 1] += color_offsets_[c];
+            std::vector<int> pos(color_offsets_.begin(), color_offsets_.end() - 1);
+            colored_subdomains_.resize(colors.size());
+            for(size_t s = 0; s < colors.size(); ++s)
+                colored_subdomains_[pos[colors[s]]++] = static_cast<int>(s);
+        }
+
+    private:
+        // the subdomain of each node
+        std::vector<int> part_;
+        std::vector<std::unique_ptr<Subdomain>> subdomains_;
+
+        std::vector<int> color_offsets_, colored_subdomains_;
+        int n_threads_ = 1;
+    };
+}
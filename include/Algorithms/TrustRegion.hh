@@ -0,0 +1,182 @@
+#pragma once
+
+#include <FunctionBase/FunctionBaseSparse.hh>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    /* Performs a trust-region Newton method on a given problem.
+     * Each iteration minimizes the quadratic model m(p) = f + g^T p + 1/2 p^T H p
+     * within ||p|| <= radius by the truncated conjugate gradient of Steihaug and Toint:
+     * CG from p = 0 stops when the residual is small enough, when an iterate leaves
+     * the region, or along a direction of negative curvature, in the last two cases on
+     * the boundary of the region. Unlike the line-search Newton method, indefinite
+     * Hessians need no regularization, the negative curvature being followed as far
+     * as the region allows.
+     *
+     * The step is accepted if the ratio rho of the actual and predicted decreases is
+     * > 0.1, and the radius is divided by 4 when rho < 0.25, and doubled when rho > 0.75
+     * for a step on the boundary. The Hessian is only evaluated after accepted steps,
+     * always into the same matrix, whose sparsity pattern the problem reuses. */
+    class TrustRegion {
+    public:
+        typedef FunctionBaseSparse::Vec Vec;   ///< Eigen::VectorXd
+        typedef FunctionBaseSparse::SMat SMat; ///< Eigen::SparseMatrix<double>
+
+        // how the Steihaug-CG iterations ended
+        enum CGExit {
+            CG_CONVERGED,
+            CG_BOUNDARY,
+            CG_NEGATIVE_CURVATURE,
+            CG_MAX_ITERS
+        };
+
+
+        /**
+         * \param _problem a pointer to a specific Problem, which can be any type that
+         *        has the same interface as FunctionBaseSparse's (i.e. with eval_f, eval_gradient, etc.)
+         * \param _initial_x  the x starting point
+         * \param _eps the stopping criterion on the gradient norm
+         * \param _max_iters a capping number of iterations, accepted or rejected
+         * \param _initial_radius the radius of the first trust region
+         *
+         * \return the minimum found by the method. */
+        template <class Problem>
+        static Vec solve(Problem *_problem, const Vec& _initial_x, const double _eps = 1e-4,
+                         const int _max_iters = 1000, const double _initial_radius = 1.0) {
+            std::cout << "******** Trust Region ********" << std::endl;
+
+            // squared epsilon for stopping criterion
+            double e2 = _eps * _eps;
+
+            // get starting point
+            Vec x = _initial_x;
+
+            const int n = _problem->n_unknowns();
+            // gradient, step, trial point and the CG vectors
+            Vec g(n), p(n), x_new(n), r(n), d(n), hd(n);
+            SMat H;
+            int iter(0), n_accepted(0), n_rejected(0), n_cg(0), n_negative_curvature(0);
+            double radius = _initial_radius;
+
+            double f_x = _problem->eval_f_and_gradient(x, g);
+            _problem->eval_hessian(x, H);
+
+            while (iter < _max_iters) {
+                const double g2 = g.squaredNorm();
+                if (g2 < e2) {
+                    std::cout << "Convergence achieved with gradient norm squared < epsilon^2: " << g2 << std::endl;
+                    break;
+                }
+
+                // forcing term for superlinear convergence
+                const double g_norm = std::sqrt(g2);
+                const double tolerance = std::min(0.5, std::sqrt(g_norm)) * g_norm;
+                const CGExit cg_exit = steihaug_cg(H, g, radius, tolerance, n, p, r, d, hd, n_cg);
+                if (cg_exit == CG_NEGATIVE_CURVATURE)
+                    ++n_negative_curvature;
+
+                // predicted decrease -(g^T p + 1/2 p^T H p)
+                hd.noalias() = H * p;
+                const double predicted = -(g.dot(p) + 0.5 * p.dot(hd));
+
+                x_new = x + p;
+                const double f_new = _problem->eval_f(x_new);
+                const double rho = (f_x - f_new) / predicted;
+
+                if (rho < 0.25)
+                    radius *= 0.25;
+                else if (rho > 0.75 && cg_exit != CG_CONVERGED && cg_exit != CG_MAX_ITERS)
+                    radius *= 2.;
+
+                if (predicted > 0. && rho > 0.1) {
+                    std::swap(x, x_new);
+                    _problem->eval_gradient(x, g);
+                    _problem->eval_hessian(x, H);
+                    f_x = f_new;
+                    ++n_accepted;
+                } else {
+                    ++n_rejected;
+                    if (radius < 1e-14) {
+                        std::cout << "Warning: the trust region vanished, stopping at iteration " << iter << std::endl;
+                        break;
+                    }
+                }
+                iter++;
+
+                if (iter % 10 == 0) {
+                    std::cout << "Iteration " << iter << " | f(x) = " << f_x << " | ||g|| = " << g.norm()
+                              << " | radius = " << radius << std::endl;
+                }
+            }
+
+            if (iter == _max_iters) {
+                std::cout << "Maximum iterations reached without convergence." << std::endl;
+            }
+            std::cout << "Iterations: " << iter << " | accepted: " << n_accepted << " | rejected: " << n_rejected
+                      << " | CG iterations: " << n_cg << " | negative curvature exits: " << n_negative_curvature << std::endl;
+
+            return x;
+        }
+
+        /** Steihaug-Toint truncated CG on H p = -g within ||p|| <= _radius
+         * \param _tolerance CG stops when the residual norm is below it
+         * \param _max_cg_iters a capping number of CG iterations
+         * \param _p the output step
+         * \param _r, _d, _hd work vectors for the residual, the direction and H times it
+         * \param _n_cg incremented by the number of products with H
+         * \return how CG ended */
+        static CGExit steihaug_cg(const SMat& _H, const Vec& _g, const double _radius, const double _tolerance,
+                                  const int _max_cg_iters, Vec& _p, Vec& _r, Vec& _d, Vec& _hd, int& _n_cg) {
+            _p.setZero(_g.size());
+            _r = _g;
+            _d = -_g;
+            double rr = _r.squaredNorm();
+            const double tolerance2 = _tolerance * _tolerance;
+
+            for (int j = 0; j < _max_cg_iters; ++j) {
+                _hd.noalias() = _H * _d;
+                ++_n_cg;
+
+                const double dhd = _d.dot(_hd);
+                if (dhd <= 0.) {
+                    // the model decreases without bound along d, go to the boundary
+                    _p += to_boundary(_p, _d, _radius) * _d;
+                    return CG_NEGATIVE_CURVATURE;
+                }
+
+                const double alpha = rr / dhd;
+                if (_p.squaredNorm() + alpha * (2. * _p.dot(_d) + alpha * _d.squaredNorm()) >= _radius * _radius) {
+                    _p += to_boundary(_p, _d, _radius) * _d;
+                    return CG_BOUNDARY;
+                }
+
+                _p += alpha * _d;
+                _r += alpha * _hd;
+
+                const double rr_new = _r.squaredNorm();
+                if (rr_new <= tolerance2)
+                    return CG_CONVERGED;
+
+                _d = -_r + (rr_new / rr) * _d;
+                rr = rr_new;
+            }
+
+            return CG_MAX_ITERS;
+        }
+
+    private:
+        // positive tau with ||_p + tau _d|| = _radius, for ||_p|| <= _radius
+        static double to_boundary(const Vec& _p, const Vec& _d, const double _radius) {
+            const double a = _d.squaredNorm();
+            const double b = _p.dot(_d);
+            const double c = _p.squaredNorm() - _radius * _radius;
+            return (-b + std::sqrt(std::max(b * b - a * c, 0.))) / a;
+        }
+    };
+}
@@ -59,6 +59,49 @@ namespace AOPT {
          * i.e _H(i,j) = (d^2f/(dx_i dx_j))(_x)
          * IMPORTANT NOTE: _H should be properly sized at the start of the function */
         virtual void eval_hessian(const Vec &_x, Mat &_H) = 0;
+
+        /** function and gradient evaluation in a single call
+         * \param _g output gradient, same convention as in eval_gradient
+         * \return the function value at _x
+         * The default implementation calls eval_gradient and eval_f.
+         * Functions that can compute both in one pass over their data
+         * (e.g. the mass spring problems) should override it. */
+        virtual double eval_f_and_gradient(const Vec &_x, Vec &_g) {
+            eval_gradient(_x, _g);
+            return eval_f(_x);
+        }
+
+        /** Hessian-vector product _hv = H(_x) * _v
+         * The default implementation assembles the dense Hessian. */
+        virtual void eval_hessian_vector(const Vec &_x, const Vec &_v, Vec &_hv) {
+            Mat H(n_unknowns(), n_unknowns());
+            eval_hessian(_x, H);
+            _hv = H * _v;
+        }
+
+        /** coefficients of the function along the line _x + t _d, for functions which are
+         * polynomials of degree at most 4, i.e. f(_x + t _d) = _p[0] + _p[1] t + ... + _p[4] t^4
+         * \param _p output, the 5 coefficients by increasing degree
+         * \return false (the default) if the function is not such a polynomial */
+        virtual bool line_polynomial(const Vec &/*_x*/, const Vec &/*_d*/, Vec &/*_p*/) {
+            return false;
+        }
+
+        // whether eval_f_concurrent can be called from several threads at once
+        virtual bool has_concurrent_eval_f() {
+            return false;
+        }
+
+        // prepares the work storage of _n_slots concurrent evaluations, see eval_f_concurrent
+        virtual void reserve_concurrent_eval_f(const int /*_n_slots*/) {}
+
+        /** function evaluation which only uses the work storage of _slot, so that several
+         * threads can evaluate it at once with different slots if has_concurrent_eval_f(),
+         * the slots [0, n) having been prepared by reserve_concurrent_eval_f(n).
+         * Defaults to eval_f, which is not thread-safe */
+        virtual double eval_f_concurrent(const Vec &_x, const int /*_slot*/) {
+            return eval_f(_x);
+        }
     };
 
 
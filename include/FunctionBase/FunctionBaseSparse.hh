@@ -49,6 +49,45 @@ namespace AOPT {
 
         // hessian matrix evaluation
         virtual void eval_hessian(const Vec &_x, SMat& _h) = 0;
+
+        // function and gradient evaluation in a single call, returns f(_x).
+        // Defaults to eval_gradient + eval_f, see FunctionBase::eval_f_and_gradient
+        virtual double eval_f_and_gradient(const Vec &_x, Vec &_g) {
+            eval_gradient(_x, _g);
+            return eval_f(_x);
+        }
+
+        // Hessian-vector product _hv = H(_x) * _v.
+        // Defaults to assembling the Hessian, problems made of small elements should
+        // override it with a matrix-free product
+        virtual void eval_hessian_vector(const Vec &_x, const Vec &_v, Vec &_hv) {
+            SMat H;
+            eval_hessian(_x, H);
+            _hv = H * _v;
+        }
+
+        // coefficients of f along the line _x + t _d, f(_x + t _d) = _p[0] + _p[1] t + ... + _p[4] t^4,
+        // for problems which are polynomials of degree at most 4 such as the mass spring problems.
+        // Returns false (the default) for the other problems
+        virtual bool line_polynomial(const Vec &/*_x*/, const Vec &/*_d*/, Vec &/*_p*/) {
+            return false;
+        }
+
+        // whether eval_f_concurrent can be called from several threads at once
+        virtual bool has_concurrent_eval_f() {
+            return false;
+        }
+
+        // prepares the work storage of _n_slots concurrent evaluations, see eval_f_concurrent
+        virtual void reserve_concurrent_eval_f(const int /*_n_slots*/) {}
+
+        // function evaluation which only uses the work storage of _slot, so that several
+        // threads can evaluate it at once with different slots if has_concurrent_eval_f(),
+        // the slots [0, n) having been prepared by reserve_concurrent_eval_f(n), see
+        // LineSearch::speculative_line_search. Defaults to eval_f, which is not thread-safe
+        virtual double eval_f_concurrent(const Vec &_x, const int /*_slot*/) {
+            return eval_f(_x);
+        }
     };
 
 
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Eigen/Sparse>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    //== CLASS DEFINITION =========================================================
+
+
+    /* Interface of the nonlinear least-squares problems
+     *   f(x) = 1/2 * ||r(x)||^2
+     * where r(x) is a vector of n_residuals() functions with a sparse Jacobian J(x).
+     *
+     * It only adds the residual form, so that problems implementing it can also be
+     * FunctionBaseSparse problems, f being their energy, its gradient J^T r and
+     * J^T J the Gauss-Newton model of its Hessian (see LevenbergMarquardt). */
+    class LeastSquaresBaseSparse {
+    public:
+        typedef Eigen::VectorXd Vec;///< (dense) vector type
+        using SMat = Eigen::SparseMatrix<double>;///< sparse matrix type
+
+        // default constructor
+        LeastSquaresBaseSparse() {}
+
+        // default destructor
+        virtual ~LeastSquaresBaseSparse() {};
+
+        // number of residuals
+        virtual int n_residuals() = 0;
+
+        // residual evaluation
+        virtual void eval_residual(const Vec &_x, Vec &_r) = 0;
+
+        /* Jacobian evaluation, n_residuals() x n_unknowns.
+         * Its sparsity pattern should only depend on the problem's structure, not on _x,
+         * so that the solvers can reuse their symbolic computations. */
+        virtual void eval_jacobian(const Vec &_x, SMat &_J) = 0;
+    };
+
+
+//=============================================================================
+}
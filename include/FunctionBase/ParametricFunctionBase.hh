@@ -45,6 +45,22 @@ namespace AOPT {
 
         // hessian matrix evaluation
         virtual void eval_hessian(const Vec &_x, const Vec &_coeffs, Mat &_H) = 0;
+
+        /** function and gradient evaluation in a single call.
+         * The default simply calls eval_gradient and eval_f, elements which share
+         * intermediate terms between the two should override it.
+         * \return the function value, the gradient is stored in _g */
+        virtual double eval_f_and_gradient(const Vec &_x, const Vec &_coeffs, Vec &_g) {
+            eval_gradient(_x, _coeffs, _g);
+            return eval_f(_x, _coeffs);
+        }
+
+        /** coefficients of the function along the line _x + t _d, for functions which are
+         * polynomials of degree at most 4, i.e. f(_x + t _d) = _p[0] + _p[1] t + ... + _p[4] t^4
+         * \return false (the default) if the function is not such a polynomial */
+        virtual bool line_polynomial(const Vec &/*_x*/, const Vec &/*_d*/, const Vec &/*_coeffs*/, double /*_p*/[5]) {
+            return false;
+        }
     };
 
 
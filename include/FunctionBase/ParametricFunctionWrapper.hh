@@ -43,6 +43,17 @@ namespace AOPT {
             param_func_.eval_hessian(_x, coeffs_, _H);
         }
 
+        // function and gradient evaluation in a single call
+        virtual double eval_f_and_gradient(const Vec &_x, Vec &_g){
+            return param_func_.eval_f_and_gradient(_x, coeffs_, _g);
+        }
+
+        // coefficients along the line _x + t _d, if the function is a polynomial of degree <= 4
+        virtual bool line_polynomial(const Vec &_x, const Vec &_d, Vec &_p){
+            _p.resize(5);
+            return param_func_.line_polynomial(_x, _d, coeffs_, _p.data());
+        }
+
 
     private:
         ParametricFunction param_func_;
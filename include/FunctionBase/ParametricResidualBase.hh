@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    //== CLASS DEFINITION =========================================================
+
+
+    /* Residual form of a parametric function which is a sum of squares,
+     * f(x) = 1/2 * ||r(x)||^2 with r a vector of n_residuals() functions.
+     *
+     * Elements implementing it in addition to ParametricFunctionBase can be used
+     * in least-squares problems (see MassSpringProblem2DLeastSquares), e.g. for the
+     * Gauss-Newton model J^T J of their Hessian, which is always positive semi-definite. */
+    class ParametricResidualBase {
+    public:
+
+        // (dense) vector type
+        typedef Eigen::VectorXd Vec;
+        // (dense) matrix type
+        typedef Eigen::MatrixXd Mat;
+
+        // default constructor
+        ParametricResidualBase() {}
+
+        // default destructor
+        virtual ~ParametricResidualBase() {};
+
+        // number of residuals
+        virtual int n_residuals() = 0;
+
+        // residual evaluation, _r should be of dimension n_residuals()
+        virtual void eval_residual(const Vec &_x, const Vec &_coeffs, Vec &_r) = 0;
+
+        // Jacobian of the residuals, _J should be n_residuals() x n_unknowns
+        virtual void eval_jacobian(const Vec &_x, const Vec &_coeffs, Mat &_J) = 0;
+    };
+
+
+//=============================================================================
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <FunctionBase/ParametricFunctionBase.hh>
+#include <FunctionBase/ParametricResidualBase.hh>
 #include <Eigen/Dense>
 
 //== NAMESPACES ===============================================================
@@ -9,8 +10,13 @@ namespace AOPT {
 
     //== CLASS DEFINITION =========================================================
 
-    class ConstrainedSpringElement2D : public ParametricFunctionBase {
+    /* Spring attaching a node to a desired point p with a penalty factor w.
+     * Its residual form is r = sqrt(w) * (x - p). */
+    class ConstrainedSpringElement2D : public ParametricFunctionBase, public ParametricResidualBase {
     public:
+        using Vec = ParametricFunctionBase::Vec;
+        using Mat = ParametricFunctionBase::Mat;
+
         ConstrainedSpringElement2D() : ParametricFunctionBase() {}
 
         // number of unknowns
@@ -54,6 +60,23 @@ namespace AOPT {
             //------------------------------------------------------//
         }
 
+        /** evaluates the spring element's energy and its gradient at once
+         * \param _x the spring's current position
+         * \param _coeffs penalty factor followed by the desired point coordinates
+         * \param _g gradient output
+         * \return the energy of the spring */
+        inline virtual double eval_f_and_gradient(const Vec &_x, const Vec &_coeffs, Vec &_g) final {
+            double penalty = _coeffs[0];
+            double dx = _x[0] - _coeffs[1];
+            double dy = _x[1] - _coeffs[2];
+
+            _g.resize(2);
+            _g[0] = penalty * dx;
+            _g[1] = penalty * dy;
+
+            return 0.5 * penalty * (dx * dx + dy * dy);
+        }
+
         /** evaluates the spring element's energy Hessian
          * \param _x the spring's current position
          * \param _coeffs _coeffs[0] is the penalty factor,
@@ -72,6 +95,58 @@ namespace AOPT {
             _H(1, 1) = penalty;
             //------------------------------------------------------//
         }
+
+        /** the energy along _x + t _d, 1/2 penalty |u + t _d|^2 with u = x - p, is of degree 2
+         * \param _p the output coefficients, by increasing degree */
+        inline virtual bool line_polynomial(const Vec &_x, const Vec &_d, const Vec &_coeffs, double _p[5]) final {
+            const double ux = _x[0] - _coeffs[1], uy = _x[1] - _coeffs[2];
+            _p[0] = 0.5 * _coeffs[0] * (ux * ux + uy * uy);
+            _p[1] = _coeffs[0] * (ux * _d[0] + uy * _d[1]);
+            _p[2] = 0.5 * _coeffs[0] * (_d[0] * _d[0] + _d[1] * _d[1]);
+            _p[3] = _p[4] = 0.;
+            return true;
+        }
+
+        // number of residuals
+        inline virtual int n_residuals() final { return 2; }
+
+        /** evaluates the residuals r = sqrt(penalty) * (x - p)
+         * \param _x the spring's current position
+         * \param _coeffs penalty factor followed by the desired point coordinates
+         * \param _r the output residuals, of dimension 2 */
+        inline virtual void eval_residual(const Vec &_x, const Vec &_coeffs, Vec &_r) final {
+            const double sw = std::sqrt(_coeffs[0]);
+            _r[0] = sw * (_x[0] - _coeffs[1]);
+            _r[1] = sw * (_x[1] - _coeffs[2]);
+        }
+
+        /** evaluates the Jacobian of the residuals, sqrt(penalty) * I
+         * \param _x the spring's current position
+         * \param _coeffs penalty factor followed by the desired point coordinates
+         * \param _J the output Jacobian, which should be a 2x2 Matrix */
+        inline virtual void eval_jacobian(const Vec &/*_x*/, const Vec &_coeffs, Mat &_J) final {
+            const double sw = std::sqrt(_coeffs[0]);
+            _J << sw, 0,
+                  0, sw;
+        }
+
+        /* Fixed-size kernels of the functions above with scalar coefficients,
+         * used by MassSpringProblem2DSparseT. _w is the penalty factor and
+         * (_px, _py) the desired point. The Hessian is simply _w * Identity. */
+        using Vec2 = Eigen::Vector2d;
+
+        static inline double f(const Vec2 &_x, const double _w, const double _px, const double _py) {
+            double dx = _x[0] - _px;
+            double dy = _x[1] - _py;
+            return 0.5 * _w * (dx * dx + dy * dy);
+        }
+
+        static inline double f_and_gradient(const Vec2 &_x, const double _w, const double _px, const double _py, Vec2 &_g) {
+            double dx = _x[0] - _px;
+            double dy = _x[1] - _py;
+            _g << _w * dx, _w * dy;
+            return 0.5 * _w * (dx * dx + dy * dy);
+        }
     };
 
     //=============================================================================
@@ -2,6 +2,8 @@
 
 #include <FunctionBase/FunctionBase.hh>
 #include <FunctionBase/ParametricFunctionBase.hh>
+#include <Utils/ReproducibleSum.hh>
+#include <Utils/BandedSymmetricMatrix.hh>
 
 //#include "FixingNodeElement.hh"
 
@@ -58,31 +60,22 @@ namespace AOPT {
          *           i.e. (_x[2*i], _x[2*i+1]) is the position of the i-th node
          * \return the sum of the energy of all the springs */
         virtual double eval_f(const Vec &_x) override {
-            double energy(0);
-
-            //used to store the value of k and l, i.e. coeff[0] = ks_[i], coeff[0] = ls_[i];
-            Vec coeff(2);
-
-            //------------------------------------------------------//
-            //TODO: assemble function values of all spring elements
-            //use vector xe_ to store the local coordinates of two nodes of every spring
-            //then pass it to func_.eval_f(...)
-            for(size_t i=0; i<springs_.size(); ++i) {
-                xe_[0] = _x[2*springs_[i].first];
-                xe_[1] = _x[2*springs_[i].first+1];
-
-                xe_[2] = _x[2*springs_[i].second];
-                xe_[3] = _x[2*springs_[i].second+1];
-
-                coeff[0] = ks_[i];
-                coeff[1] = ls_[i];
-
-                energy += func_.eval_f(xe_, coeff);
+            // summed per chunk of springs and reduced in a fixed order, see ReproducibleSum
+            const size_t n_chunks = ReproducibleSum::n_chunks(springs_.size());
+            if(n_chunks <= 1)
+                return eval_f_range(_x, 0, springs_.size(), xe_);
+
+            chunk_energy_.resize(n_chunks);
+#pragma omp parallel num_threads(n_threads_) if(n_threads_ > 1)
+            {
+                Vec xe(func_.n_unknowns());
+#pragma omp for schedule(static)
+                for(int c = 0; c < int(n_chunks); ++c)
+                    chunk_energy_[c] = eval_f_range(_x, ReproducibleSum::chunk_begin(c, springs_.size()),
+                                                    ReproducibleSum::chunk_begin(c + 1, springs_.size()), xe);
             }
-            
-            //------------------------------------------------------//
 
-            return energy;
+            return ReproducibleSum::pairwise_sum(chunk_energy_);
         }
 
 
@@ -130,6 +123,31 @@ namespace AOPT {
 
 
 
+        /** Evaluates the energy and its gradient in a single pass over the springs.
+         * Gives the same results as eval_f and eval_gradient.
+         *
+         * \param _x the problem's springs positions
+         * \param _g output gradient, see eval_gradient
+         * \return the sum of the energy of all the springs */
+        virtual double eval_f_and_gradient(const Vec &_x, Vec &_g) override {
+            _g.resize(n_unknowns());
+            _g.setZero();
+
+            // same chunks as eval_f, hence the same energy
+            const size_t n_chunks = ReproducibleSum::n_chunks(springs_.size());
+            if(n_chunks <= 1)
+                return eval_f_and_gradient_range(_x, 0, springs_.size(), _g);
+
+            chunk_energy_.resize(n_chunks);
+            for(size_t c = 0; c < n_chunks; ++c)
+                chunk_energy_[c] = eval_f_and_gradient_range(_x, ReproducibleSum::chunk_begin(c, springs_.size()),
+                                                             ReproducibleSum::chunk_begin(c + 1, springs_.size()), _g);
+
+            return ReproducibleSum::pairwise_sum(chunk_energy_);
+        }
+
+
+
         /** The problem's energy Hessian is a composition of the individual Hessian
          * of each of its springs.
          * \param _x the problem's springs positions.
@@ -188,6 +206,55 @@ namespace AOPT {
         }
 
 
+        /** Bandwidth of the Hessian, i.e. the largest |i - j| of its non-zeros (i, j).
+         * A spring between the nodes a and b couples the unknowns 2a, 2a+1, 2b and 2b+1,
+         * so this is 2 * max |a - b| + 1 over the springs. With the row-major numbering of
+         * MassSpringSystemT's grids, it is 2 * (n_grid_x + 2) + 1 */
+        int hessian_bandwidth() const {
+            int bandwidth(0);
+            for(const auto& spring : springs_)
+                bandwidth = std::max(bandwidth, 2 * std::abs(spring.first - spring.second) + 1);
+            return bandwidth;
+        }
+
+        /** Same as eval_hessian, stored as a banded symmetric matrix of bandwidth
+         * hessian_bandwidth(), which needs O(n * bandwidth) memory instead of O(n^2).
+         * _h is resized if needed. */
+        void eval_hessian(const Vec &_x, BandedSymmetricMatrix& _h) {
+            const int bandwidth = hessian_bandwidth();
+            if(_h.rows() != n_unknowns() || _h.bandwidth() != bandwidth)
+                _h.resize(n_unknowns(), bandwidth);
+            else
+                _h.setZero();
+
+            //used to store the value of k and l, i.e. coeff[0] = ks_[i];
+            Vec coeff(2);
+            int ids[4];
+
+            for(size_t i=0; i<springs_.size(); ++i) {
+                ids[0] = 2 * springs_[i].first;
+                ids[1] = 2 * springs_[i].first + 1;
+                ids[2] = 2 * springs_[i].second;
+                ids[3] = 2 * springs_[i].second + 1;
+
+                for(int j=0; j<4; ++j)
+                    xe_[j] = _x[ids[j]];
+
+                coeff[0] = ks_[i];
+                coeff[1] = ls_[i];
+
+                func_.eval_hessian(xe_, coeff, he_);
+
+                // only the lower band is stored, he_ being symmetric each off-diagonal
+                // pair is added once
+                for(int c=0; c<4; ++c)
+                    for(int r=0; r<4; ++r)
+                        if(ids[r] >= ids[c])
+                            _h.lower(ids[r], ids[c]) += he_(r, c);
+            }
+        }
+
+
         void add_spring_element(const int _v_idx0, const int _v_idx1, const double _k = 1., const double _l = 1.) {
             if (2 * _v_idx0 > (int) n_ || _v_idx0 < 0 || 2 * _v_idx1 >= (int) n_ || _v_idx1 < 0)
                 std::cout << "Warning: invalid spring element was added... " << _v_idx0 << " " << _v_idx1 << std::endl;
@@ -199,7 +266,73 @@ namespace AOPT {
         }
 
 
+        /** Sets the number of threads used by eval_f. The springs are summed per
+         * chunk and reduced in a fixed order (see ReproducibleSum), so the energy is
+         * bitwise identical for any number of threads. Problems with a single chunk
+         * are always evaluated serially. 1 (the default) is serial. */
+        void set_n_threads(const int _n_threads) {
+            n_threads_ = std::max(1, _n_threads);
+        }
+
+        int n_threads() const { return n_threads_; }
+
+
     private:
+        /** sequential sum of the energy of the springs [_begin, _end)
+         * \param _xe buffer for the element coordinates */
+        double eval_f_range(const Vec &_x, const size_t _begin, const size_t _end, Vec& _xe) {
+            double energy(0);
+
+            //used to store the value of k and l, i.e. coeff[0] = ks_[i], coeff[0] = ls_[i];
+            Vec coeff(2);
+
+            //------------------------------------------------------//
+            //TODO: assemble function values of all spring elements
+            //use vector xe_ to store the local coordinates of two nodes of every spring
+            //then pass it to func_.eval_f(...)
+            for(size_t i=_begin; i<_end; ++i) {
+                _xe[0] = _x[2*springs_[i].first];
+                _xe[1] = _x[2*springs_[i].first+1];
+
+                _xe[2] = _x[2*springs_[i].second];
+                _xe[3] = _x[2*springs_[i].second+1];
+
+                coeff[0] = ks_[i];
+                coeff[1] = ls_[i];
+
+                energy += func_.eval_f(_xe, coeff);
+            }
+            
+            //------------------------------------------------------//
+
+            return energy;
+        }
+
+        // same as eval_f_range, also adding the springs' gradients to _g
+        double eval_f_and_gradient_range(const Vec &_x, const size_t _begin, const size_t _end, Vec &_g) {
+            double energy(0);
+            Vec coeff(2);
+            for(size_t i=_begin; i<_end; ++i) {
+                xe_[0] = _x[2 * springs_[i].first];
+                xe_[1] = _x[2 * springs_[i].first + 1];
+
+                xe_[2] = _x[2 * springs_[i].second];
+                xe_[3] = _x[2 * springs_[i].second + 1];
+
+                coeff[0] = ks_[i];
+                coeff[1] = ls_[i];
+
+                energy += func_.eval_f_and_gradient(xe_, coeff, ge_);
+
+                _g[2 * springs_[i].first] += ge_[0];
+                _g[2 * springs_[i].first + 1] += ge_[1];
+                _g[2 * springs_[i].second] += ge_[2];
+                _g[2 * springs_[i].second + 1] += ge_[3];
+            }
+
+            return energy;
+        }
+
         int n_;
         std::vector<Edge> springs_;
 
@@ -215,6 +348,10 @@ namespace AOPT {
         Vec ge_;
         // hessian of each spring element
         Mat he_;
+
+        int n_threads_ = 1;
+        // energy of each chunk of springs, see ReproducibleSum
+        std::vector<double> chunk_energy_;
     };
 
 //=============================================================================
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <FunctionBase/LeastSquaresBaseSparse.hh>
+#include <FunctionBase/ParametricResidualBase.hh>
+#include <Functions/MassSpringProblem2DSparse.hh>
+#include <algorithm>
+#include <stdexcept>
+
+namespace AOPT {
+
+    /* Least-squares form of MassSpringProblem2DSparse.
+     * The energy of each spring element and constrained node is 1/2 * ||r||^2 with the
+     * residuals given by its ParametricResidualBase form, so the problem's energy is
+     * 1/2 * ||r(x)||^2 with r the concatenation of
+     *  - the residuals of the springs, n_residuals() of the spring element per spring,
+     *  - then those of the constrained nodes, 2 per node.
+     *
+     * The energy, gradient and Hessian are the ones of MassSpringProblem2DSparse.
+     * The Jacobian's sparsity pattern is cached like the Hessian's, each residual row
+     * having the entries of the element's nodes, and only its values are refilled. */
+    class MassSpringProblem2DLeastSquares : public MassSpringProblem2DSparse, public LeastSquaresBaseSparse {
+    public:
+        using Vec = MassSpringProblem2DSparse::Vec;
+        using Mat = MassSpringProblem2DSparse::Mat;
+        using SMat = MassSpringProblem2DSparse::SMat;
+        using T = MassSpringProblem2DSparse::T;
+
+        /** \param _spring the spring element, which should also implement ParametricResidualBase,
+         *        since least-squares solvers would otherwise minimize another energy
+         *        than the problem's one
+         * \throws std::invalid_argument if it does not */
+        MassSpringProblem2DLeastSquares(ParametricFunctionBase& _spring, const int _n_unknowns) :
+                MassSpringProblem2DSparse(_spring, _n_unknowns),
+                res_(dynamic_cast<ParametricResidualBase*>(&_spring)),
+                m_(0)
+        {
+            if(res_ == nullptr)
+                throw std::invalid_argument("MassSpringProblem2DLeastSquares: the spring element has no residual form");
+            m_ = res_->n_residuals();
+
+            re_.resize(m_);
+            je_.resize(m_, func_.n_unknowns());
+            cs_re_.resize(cse_.n_residuals());
+            cs_je_.resize(cse_.n_residuals(), cse_.n_unknowns());
+        }
+
+        ~MassSpringProblem2DLeastSquares() {}
+
+        virtual int n_residuals() override {
+            return static_cast<int>(m_ * i0_.size() + 2 * attached_node_indices_.size());
+        }
+
+        /** evaluates the residuals of all the springs followed by the ones of the
+         * constrained nodes, 1/2 * ||_r||^2 being the problem's energy
+         * \param _x the problem's springs positions
+         * \param _r the output residuals, resized to n_residuals() */
+        virtual void eval_residual(const Vec &_x, Vec &_r) override {
+            _r.resize(n_residuals());
+
+            int row = 0;
+            for(size_t i=0; i<i0_.size(); ++i) {
+                xe_[0] = _x[2 * i0_[i]];
+                xe_[1] = _x[2 * i0_[i] + 1];
+                xe_[2] = _x[2 * i1_[i]];
+                xe_[3] = _x[2 * i1_[i] + 1];
+
+                coeff_[0] = ks_[i];
+                coeff_[1] = ls_[i];
+
+                res_->eval_residual(xe_, coeff_, re_);
+                for(int r=0; r<m_; ++r)
+                    _r[row++] = re_[r];
+            }
+
+            for(size_t i = 0; i < attached_node_indices_.size(); ++i) {
+                cs_xe_[0] = _x[2 * attached_node_indices_[i]];
+                cs_xe_[1] = _x[2 * attached_node_indices_[i] + 1];
+
+                cs_coeff_[0] = weights_[i];
+                cs_coeff_[1] = desired_points_[2 * i];
+                cs_coeff_[2] = desired_points_[2 * i + 1];
+
+                cse_.eval_residual(cs_xe_, cs_coeff_, cs_re_);
+                _r[row++] = cs_re_[0];
+                _r[row++] = cs_re_[1];
+            }
+        }
+
+        /** evaluates the Jacobian of the residuals.
+         * If _J already has the cached pattern (e.g. from the previous call), only its
+         * values are overwritten and no memory is allocated
+         * \param _x the problem's springs positions
+         * \param _J the output n_residuals() x n_unknowns() Jacobian */
+        virtual void eval_jacobian(const Vec &_x, SMat &_J) override {
+            if(!has_jacobian_pattern())
+                setup_jacobian_pattern();
+            if(!_J.isCompressed() || _J.nonZeros() != jacobian_pattern_.nonZeros()
+               || _J.rows() != jacobian_pattern_.rows() || _J.cols() != jacobian_pattern_.cols())
+                _J = jacobian_pattern_;
+
+            double* values = _J.valuePtr();
+            const int* slots = jacobian_slots_.data();
+
+            for(size_t i=0; i<i0_.size(); ++i) {
+                xe_[0] = _x[2 * i0_[i]];
+                xe_[1] = _x[2 * i0_[i] + 1];
+                xe_[2] = _x[2 * i1_[i]];
+                xe_[3] = _x[2 * i1_[i] + 1];
+
+                coeff_[0] = ks_[i];
+                coeff_[1] = ls_[i];
+
+                res_->eval_jacobian(xe_, coeff_, je_);
+                // column-major, as the slots
+                for(int j=0; j<je_.size(); ++j)
+                    values[*slots++] = je_.data()[j];
+            }
+
+            for(size_t i = 0; i < attached_node_indices_.size(); ++i) {
+                cs_xe_[0] = _x[2 * attached_node_indices_[i]];
+                cs_xe_[1] = _x[2 * attached_node_indices_[i] + 1];
+
+                cs_coeff_[0] = weights_[i];
+                cs_coeff_[1] = desired_points_[2 * i];
+                cs_coeff_[2] = desired_points_[2 * i + 1];
+
+                cse_.eval_jacobian(cs_xe_, cs_coeff_, cs_je_);
+                for(int j=0; j<4; ++j)
+                    values[*slots++] = cs_je_.data()[j];
+            }
+        }
+
+    protected:
+        // the cached pattern is kept as long as the numbers of springs and constrained nodes
+        bool has_jacobian_pattern() const {
+            return jacobian_pattern_.cols() == n_ && jacobian_n_springs_ == i0_.size()
+                   && jacobian_n_cs_ == attached_node_indices_.size();
+        }
+
+        /** Builds the compressed pattern of the Jacobian and stores, for each spring
+         * (resp. constrained node), the offsets into valuePtr() of its m x 4 (resp. 2 x 2)
+         * local entries in column-major order */
+        void setup_jacobian_pattern() {
+            std::vector<T> triplets;
+            triplets.reserve(4 * m_ * i0_.size() + 4 * attached_node_indices_.size());
+
+            int row = 0;
+            for(size_t i=0; i<i0_.size(); ++i, row += m_) {
+                const int ids[4] = {2 * i0_[i], 2 * i0_[i] + 1,
+                                    2 * i1_[i], 2 * i1_[i] + 1};
+                for(int c=0; c<4; ++c)
+                    for(int r=0; r<m_; ++r)
+                        triplets.emplace_back(row + r, ids[c], 0.);
+            }
+
+            for(size_t i=0; i<attached_node_indices_.size(); ++i, row += 2) {
+                const int ids[2] = {2 * attached_node_indices_[i], 2 * attached_node_indices_[i] + 1};
+                for(int c=0; c<2; ++c)
+                    for(int r=0; r<2; ++r)
+                        triplets.emplace_back(row + r, ids[c], 0.);
+            }
+
+            jacobian_pattern_.resize(n_residuals(), n_unknowns());
+            jacobian_pattern_.setFromTriplets(triplets.begin(), triplets.end());
+            jacobian_pattern_.makeCompressed();
+
+            // triplets were generated in the same order as the local entries
+            jacobian_slots_.resize(triplets.size());
+            for(size_t i=0; i<triplets.size(); ++i)
+                jacobian_slots_[i] = jacobian_slot(triplets[i].row(), triplets[i].col());
+
+            jacobian_n_springs_ = i0_.size();
+            jacobian_n_cs_ = attached_node_indices_.size();
+        }
+
+        // offset of the entry (_row, _col) in jacobian_pattern_.valuePtr()
+        int jacobian_slot(const int _row, const int _col) const {
+            const int* inner = jacobian_pattern_.innerIndexPtr();
+            const int* begin = inner + jacobian_pattern_.outerIndexPtr()[_col];
+            const int* end = inner + jacobian_pattern_.outerIndexPtr()[_col + 1];
+            return static_cast<int>(std::lower_bound(begin, end, _row) - inner);
+        }
+
+    protected:
+        // residual form of the spring element, and its number of residuals
+        ParametricResidualBase* res_;
+        int m_;
+        Vec re_;
+        Mat je_;
+        Vec cs_re_;
+        Mat cs_je_;
+
+        // cached Jacobian structure, for the given numbers of springs and constrained nodes
+        SMat jacobian_pattern_;
+        std::vector<int> jacobian_slots_;
+        size_t jacobian_n_springs_ = 0;
+        size_t jacobian_n_cs_ = 0;
+    };
+}
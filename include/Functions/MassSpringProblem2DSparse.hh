@@ -3,6 +3,13 @@
 #include <FunctionBase/FunctionBaseSparse.hh>
 #include <FunctionBase/ParametricFunctionBase.hh>
 #include <Functions/ConstrainedSpringElement2D.hh>
+#include <Utils/ReproducibleSum.hh>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace AOPT {
 
@@ -21,8 +28,18 @@ namespace AOPT {
             func_(_spring)
         {
             xe_.resize(func_.n_unknowns());
-            ge_.resize(func_.n_unknowns());
             he_.resize(func_.n_unknowns(), func_.n_unknowns());
+
+            de_.resize(func_.n_unknowns());
+
+            cs_xe_.resize(cse_.n_unknowns());
+            cs_de_.resize(cse_.n_unknowns());
+
+            coeff_.resize(2);
+            cs_coeff_.resize(3);
+
+            // slot 0 of eval_f_concurrent
+            reserve_thread_buffers(1);
         }
 
         ~MassSpringProblem2DSparse() {}
@@ -39,43 +56,54 @@ namespace AOPT {
          *           i.e. (_x[2*i], _x[2*i+1]) is the position of the i-th node
          * \return the sum of the energy of all the springs */
         virtual double eval_f(const Vec &_x) override {
-            double energy = 0;
-            Vec coeff(2);
-
-            //------------------------------------------------------//
-            // TODO: (done!) assemble function values of all spring elements
-            // use vector xe_ to store the local coordinates of two nodes of every spring
-            // then pass it to func_.eval_f(...)
-            for(size_t i = 0; i < springs_.size(); ++i) {
-                xe_[0] = _x[2 * springs_[i].first];
-                xe_[1] = _x[2 * springs_[i].first + 1];
-                xe_[2] = _x[2 * springs_[i].second];
-                xe_[3] = _x[2 * springs_[i].second + 1];
-
-                coeff[0] = ks_[i];
-                coeff[1] = ls_[i];
-
-                energy += func_.eval_f(xe_, coeff);
+            // the energy terms are the springs followed by the constrained nodes,
+            // summed per chunk and reduced in a fixed order, see ReproducibleSum
+            const size_t n_terms = n_energy_terms();
+            const size_t n_chunks = ReproducibleSum::n_chunks(n_terms);
+            if(n_chunks <= 1)
+                return eval_f_range(_x, 0, n_terms, xe_, coeff_, cs_xe_, cs_coeff_);
+
+            chunk_energy_.resize(n_chunks);
+            if(n_threads_ > 1) {
+#pragma omp parallel num_threads(n_threads_)
+                {
+                    ThreadBuffers& b = thread_buffers_[thread_index()];
+#pragma omp for schedule(static)
+                    for(int c = 0; c < int(n_chunks); ++c)
+                        chunk_energy_[c] = eval_f_range(_x, ReproducibleSum::chunk_begin(c, n_terms),
+                                                        ReproducibleSum::chunk_begin(c + 1, n_terms),
+                                                        b.xe, b.coeff, b.cs_xe, b.cs_coeff);
+                }
+            } else {
+                for(size_t c = 0; c < n_chunks; ++c)
+                    chunk_energy_[c] = eval_f_range(_x, ReproducibleSum::chunk_begin(c, n_terms),
+                                                    ReproducibleSum::chunk_begin(c + 1, n_terms),
+                                                    xe_, coeff_, cs_xe_, cs_coeff_);
             }
-            //------------------------------------------------------//
 
-            //------------------------------------------------------//
-            // TODO: (done!) assemble function values of all the constrained spring elements
-            // use cs_xe_ to store the coordinate of the attached node index
-            // and cse_ to compute the attached node's functions
-            for(size_t i = 0; i < attached_node_indices_.size(); ++i) {
-                cs_xe_[0] = _x[2 * attached_node_indices_[i]];
-                cs_xe_[1] = _x[2 * attached_node_indices_[i] + 1];
-                
-                Vec cs_coeff(1);
-                cs_coeff[0] = weights_[i];
+            return ReproducibleSum::pairwise_sum(chunk_energy_);
+        }
 
-                energy += cse_.eval_f(cs_xe_, cs_coeff);
+        virtual bool has_concurrent_eval_f() override {
+            return true;
+        }
 
-            }
-            //------------------------------------------------------//
-            
-            return energy;
+        virtual void reserve_concurrent_eval_f(const int _n_slots) override {
+            reserve_thread_buffers(_n_slots);
+        }
+
+        /** Same energy as eval_f, evaluated serially with the element buffers of the thread
+         * _slot instead of the problem's, and reducing the chunk energies without storing
+         * them, so that several threads can evaluate it at once, e.g. at different trial
+         * points of LineSearch::speculative_line_search. */
+        virtual double eval_f_concurrent(const Vec &_x, const int _slot) override {
+            ThreadBuffers& b = thread_buffers_[_slot];
+            const size_t n_terms = n_energy_terms();
+            return ReproducibleSum::pairwise_sum_of_chunks([&](const size_t _c) {
+                return eval_f_range(_x, ReproducibleSum::chunk_begin(_c, n_terms),
+                                    ReproducibleSum::chunk_begin(_c + 1, n_terms),
+                                    b.xe, b.coeff, b.cs_xe, b.cs_coeff);
+            }, 0, std::max<size_t>(ReproducibleSum::n_chunks(n_terms), 1));
         }
 
         /** The problem's energy gradient is a composition of the individual gradient
@@ -91,46 +119,23 @@ namespace AOPT {
         virtual void eval_gradient(const Vec &_x, Vec &_g) override {
             _g.resize(n_unknowns());
             _g.setZero();
-            Vec coeff(2);
-
-            //------------------------------------------------------//
-            // TODO: (done!) assemble local gradient vector to the global one
-            // use ge_ to store the result of the local gradient
-            for(size_t i=0; i<springs_.size(); ++i) {
-                xe_[0] = _x[2 * springs_[i].first];
-                xe_[1] = _x[2 * springs_[i].first + 1];
-                xe_[2] = _x[2 * springs_[i].second];
-                xe_[3] = _x[2 * springs_[i].second + 1];
-
-                coeff[0] = ks_[i];
-                coeff[1] = ls_[i];
-                
-                func_.eval_gradient(xe_, coeff, ge_);
-
-                _g[2 * springs_[i].first] += ge_[0];
-                _g[2 * springs_[i].first + 1] += ge_[1];
-                _g[2 * springs_[i].second] += ge_[2];
-                _g[2 * springs_[i].second + 1] += ge_[3];
-            }
-            //------------------------------------------------------//
-
-            //------------------------------------------------------//
-            // TODO: (done!) assemble local gradient vector of all the constrained spring elements to the global one
-            // use cs_ge_ to store the gradient of the attached node index
-            for(size_t i = 0; i < attached_node_indices_.size(); ++i) {
-                cs_xe_[0] = _x[2 * attached_node_indices_[i]];
-                cs_xe_[1] = _x[2 * attached_node_indices_[i] + 1];
-
-                Vec cs_coeff(1);
-                cs_coeff[0] = weights_[i];
 
-                cse_.eval_gradient(cs_xe_, cs_coeff, cs_ge_);
+            // the springs follow the coloring with any number of threads, see set_n_threads
+            assemble_gradient_colored<false>(_x, _g);
+        }
 
+        /** Evaluates the energy and its gradient in a single pass over the springs,
+         * i.e. each spring's node coordinates are only loaded once.
+         * Gives the same results as eval_f and eval_gradient.
+         *
+         * \param _x the problem's springs positions
+         * \param _g output gradient, see eval_gradient
+         * \return the sum of the energy of all the springs */
+        virtual double eval_f_and_gradient(const Vec &_x, Vec &_g) override {
+            _g.resize(n_unknowns());
+            _g.setZero();
 
-                _g[2 * attached_node_indices_[i]] += cs_ge_[0];
-                _g[2 * attached_node_indices_[i] + 1] += cs_ge_[1];
-            }
-            //------------------------------------------------------//
+            return assemble_gradient_colored<true>(_x, _g);
         }
 
         /** The problem's energy Hessian is a composition of the individual Hessian
@@ -143,86 +148,116 @@ namespace AOPT {
          *           It should contain the positions of all nodes of the system.
          *           i.e. (_x[2*i], _x[2*i+1]) is the position of the i-th node **/
         virtual void eval_hessian(const Vec &_x, SMat& _h) override {
-            std::vector<T> triplets;
-            triplets.reserve(16 * springs_.size());
+            // the sparsity pattern only depends on the topology, so it is built
+            // once and each call only refills the values of the non-zeros
+            if(!hessian_pattern_valid_)
+                setup_hessian_pattern();
 
-            Vec coeff(2);
-            //------------------------------------------------------//
-            // TODO: (done!) assemble local hessian matrix to the global one
-            // use he_ to store the local hessian matrix
-            for(int i=0; i<ks_.size(); ++i) {
-                int id0 = 2 * springs_[i].first;
-                int id1 = 2 * springs_[i].first + 1;
-                int id2 = 2 * springs_[i].second;
-                int id3 = 2 * springs_[i].second + 1;
-
-                xe_[0] = _x[id0];
-                xe_[1] = _x[id1];
-                xe_[2] = _x[id2];
-                xe_[3] = _x[id3];
-
-                coeff[0] = ks_[i];
-                coeff[1] = ls_[i];
-
-                func_.eval_hessian(xe_, coeff, he_);
-
-                triplets.emplace_back(id0, id0, he_(0,0));
-                triplets.emplace_back(id0, id1, he_(0,1));
-                triplets.emplace_back(id0, id2, he_(0,2));
-                triplets.emplace_back(id0, id3, he_(0,3));
-
-                triplets.emplace_back(id1, id0, he_(1,0));
-                triplets.emplace_back(id1, id1, he_(1,1));
-                triplets.emplace_back(id1, id2, he_(1,2));
-                triplets.emplace_back(id1, id3, he_(1,3));
-
-                triplets.emplace_back(id2, id0, he_(2,0));
-                triplets.emplace_back(id2, id1, he_(2,1));
-                triplets.emplace_back(id2, id2, he_(2,2));
-                triplets.emplace_back(id2, id3, he_(2,3));
-
-                triplets.emplace_back(id3, id0, he_(3,0));
-                triplets.emplace_back(id3, id1, he_(3,1));
-                triplets.emplace_back(id3, id2, he_(3,2));
-                triplets.emplace_back(id3, id3, he_(3,3));
-            }
-            //------------------------------------------------------//
+            // (re)use _h's storage if it already has the cached structure
+            if(!has_hessian_pattern(_h))
+                _h = hessian_pattern_;
 
-            //------------------------------------------------------//
-            // TODO: (done!) assemble local hessian matrix of all the constrained spring elements to the global one
-            // use cs_he_ to store the hessian of the attached node index
-            for (size_t i = 0; i < attached_node_indices_.size(); ++i) {
-                int idx0 = 2 * attached_node_indices_[i];
-                int idx1 = idx0 + 1;
+            double* values = _h.valuePtr();
+            std::fill(values, values + _h.nonZeros(), 0.);
 
-                cs_xe_[0] = _x[idx0];
-                cs_xe_[1] = _x[idx1];
+            // the springs follow the coloring with any number of threads, see set_n_threads
+            assemble_hessian_colored(_x, values);
+        }
 
-                Vec cs_coeff(1);
-                cs_coeff[0] = weights_[i];
+        /** Matrix-free Hessian-vector product: each spring's local Hessian is applied
+         * to its nodes' entries of _v and accumulated into _hv, without assembling
+         * the (16 entries per spring) sparse Hessian.
+         *
+         * \param _x the problem's springs positions
+         * \param _v the vector to multiply, of dimension n_unknowns()
+         * \param _hv output, H(_x) * _v */
+        virtual void eval_hessian_vector(const Vec &_x, const Vec &_v, Vec &_hv) override {
+            _hv.resize(n_unknowns());
+            _hv.setZero();
+
+            for(size_t i=0; i<i0_.size(); ++i) {
+                const int ids[4] = {2 * i0_[i], 2 * i0_[i] + 1,
+                                    2 * i1_[i], 2 * i1_[i] + 1};
+                for(int j=0; j<4; ++j)
+                    xe_[j] = _x[ids[j]];
+
+                coeff_[0] = ks_[i];
+                coeff_[1] = ls_[i];
+
+                func_.eval_hessian(xe_, coeff_, he_);
+
+                for(int c=0; c<4; ++c) {
+                    const double vc = _v[ids[c]];
+                    for(int r=0; r<4; ++r)
+                        _hv[ids[r]] += he_(r, c) * vc;
+                }
+            }
 
-                cse_.eval_hessian(cs_xe_, cs_coeff, cs_he_);
+            // the Hessian of a constrained node is its weight times the identity
+            for(size_t i = 0; i < attached_node_indices_.size(); ++i) {
+                const int a = 2 * attached_node_indices_[i];
+                _hv[a] += weights_[i] * _v[a];
+                _hv[a + 1] += weights_[i] * _v[a + 1];
+            }
+        }
 
+        /** Coefficients of the energy along the line _x + t _d, a polynomial of degree 4
+         * (2 for the springs without length), accumulated in one pass over the springs and
+         * the constrained nodes, e.g. for LineSearch::exact_line_search.
+         * \param _p output, the 5 coefficients by increasing degree
+         * \return false if the spring element is not a polynomial, see
+         *         ParametricFunctionBase::line_polynomial */
+        virtual bool line_polynomial(const Vec &_x, const Vec &_d, Vec &_p) override {
+            _p.setZero(5);
+            double pe[5];
+
+            for(size_t i = 0; i < i0_.size(); ++i) {
+                xe_[0] = _x[2 * i0_[i]];
+                xe_[1] = _x[2 * i0_[i] + 1];
+                xe_[2] = _x[2 * i1_[i]];
+                xe_[3] = _x[2 * i1_[i] + 1];
+                de_[0] = _d[2 * i0_[i]];
+                de_[1] = _d[2 * i0_[i] + 1];
+                de_[2] = _d[2 * i1_[i]];
+                de_[3] = _d[2 * i1_[i] + 1];
+
+                coeff_[0] = ks_[i];
+                coeff_[1] = ls_[i];
+
+                if(!func_.line_polynomial(xe_, de_, coeff_, pe))
+                    return false;
+                for(int j = 0; j < 5; ++j)
+                    _p[j] += pe[j];
+            }
 
-                triplets.emplace_back(idx0, idx0, cs_he_(0, 0));
-                triplets.emplace_back(idx0, idx1, cs_he_(0, 1));
-                triplets.emplace_back(idx1, idx0, cs_he_(1, 0));
-                triplets.emplace_back(idx1, idx1, cs_he_(1, 1));
+            for(size_t i = 0; i < attached_node_indices_.size(); ++i) {
+                cs_xe_[0] = _x[2 * attached_node_indices_[i]];
+                cs_xe_[1] = _x[2 * attached_node_indices_[i] + 1];
+                cs_de_[0] = _d[2 * attached_node_indices_[i]];
+                cs_de_[1] = _d[2 * attached_node_indices_[i] + 1];
+
+                cs_coeff_[0] = weights_[i];
+                cs_coeff_[1] = desired_points_[2 * i];
+                cs_coeff_[2] = desired_points_[2 * i + 1];
+
+                cse_.line_polynomial(cs_xe_, cs_de_, cs_coeff_, pe);
+                for(int j = 0; j < 5; ++j)
+                    _p[j] += pe[j];
             }
-            //------------------------------------------------------//
 
-            _h.resize(n_unknowns(), n_unknowns());
-            _h.setZero();
-            _h.setFromTriplets(triplets.begin(), triplets.end());
+            return true;
         }
 
         void add_spring_element(const int _v_idx0, const int _v_idx1, const double _k = 1., const double _l = 1.) {
             if (2 * _v_idx0 > (int) n_ || _v_idx0 < 0 || 2 * _v_idx1 >= (int) n_ || _v_idx1 < 0)
                 std::cout << "Warning: invalid spring element was added... " << _v_idx0 << " " << _v_idx1 << std::endl;
             else {
-                springs_.emplace_back(_v_idx0, _v_idx1);
+                i0_.push_back(_v_idx0);
+                i1_.push_back(_v_idx1);
                 ks_.push_back(_k);
                 ls_.push_back(_l);
+                hessian_pattern_valid_ = false;
+                spring_coloring_valid_ = false;
             }
         }
 
@@ -234,24 +269,483 @@ namespace AOPT {
                 weights_.push_back(_w);
                 desired_points_.push_back(_px);
                 desired_points_.push_back(_py);
+                hessian_pattern_valid_ = false;
+                spring_coloring_valid_ = false;
             }
         }
 
-    private:
+        size_t n_springs() const {
+            return i0_.size();
+        }
+
+        // the two nodes of the _i-th spring
+        Edge spring_nodes(const size_t _i) const {
+            return Edge(i0_[_i], i1_[_i]);
+        }
+
+        /** Sub-problem made of the springs and constrained nodes whose nodes all are in a
+         * subset of the nodes, e.g. for domain decomposition. It shares the spring element of
+         * this problem, which, as for set_n_threads, must be stateless for the problems to be
+         * evaluated concurrently.
+         * \param _local_index the index in the sub-problem of each node of this problem, -1 if not in it
+         * \param _n_local_nodes the number of nodes of the sub-problem
+         * \return a problem on 2 * _n_local_nodes unknowns */
+        std::shared_ptr<MassSpringProblem2DSparse> make_subproblem(const std::vector<int>& _local_index,
+                                                                   const int _n_local_nodes) const {
+            auto sub = std::make_shared<MassSpringProblem2DSparse>(func_, 2 * _n_local_nodes);
+            for(size_t i = 0; i < i0_.size(); ++i)
+                if(_local_index[i0_[i]] >= 0 && _local_index[i1_[i]] >= 0)
+                    sub->add_spring_element(_local_index[i0_[i]], _local_index[i1_[i]], ks_[i], ls_[i]);
+            for(size_t i = 0; i < attached_node_indices_.size(); ++i)
+                if(_local_index[attached_node_indices_[i]] >= 0)
+                    sub->add_constrained_spring_element(_local_index[attached_node_indices_[i]], weights_[i],
+                                                        desired_points_[2 * i], desired_points_[2 * i + 1]);
+            return sub;
+        }
+
+        /** Sets the number of threads used by the energy, gradient and Hessian evaluations.
+         * The gradient and the Hessian are assembled color by color following a greedy
+         * edge coloring of the spring graph (see setup_spring_coloring).
+         * Since no two springs of a color share a node, each color is processed in
+         * parallel without any atomic operation, the Hessian being written directly
+         * into the slots of its cached pattern. The serial path follows the same
+         * coloring, so that each node's contributions are summed in the same order,
+         * and the gradient and the Hessian are bitwise identical for any number of threads.
+         * This requires OpenMP and a spring element that can be evaluated concurrently,
+         * i.e. without internal state, which is the case of all elements of this framework.
+         * The energy is evaluated per chunk of springs and reduced in a fixed order
+         * (see ReproducibleSum), so it is bitwise identical for any number of threads too,
+         * hence so are the iterates of the solvers.
+         * Problems with a single chunk are always evaluated serially.
+         * 1 (the default) uses the serial path. */
+        void set_n_threads(const int _n_threads) {
+            n_threads_ = std::max(1, _n_threads);
+            reserve_thread_buffers(n_threads_);
+        }
+
+        int n_threads() const { return n_threads_; }
+
+        // color of each spring in the cached edge coloring, computed if needed
+        const std::vector<int>& spring_colors() {
+            if(!spring_coloring_valid_)
+                setup_spring_coloring();
+            return spring_colors_;
+        }
+
+        int n_spring_colors() {
+            if(!spring_coloring_valid_)
+                setup_spring_coloring();
+            return static_cast<int>(color_offsets_.size()) - 1;
+        }
+
+    protected:
+        /** Greedy edge coloring of the spring graph: each spring gets the smallest color
+         * not yet used by a spring sharing one of its nodes. The springs are then grouped
+         * by color, i.e. the springs of color c are
+         * colored_springs_[color_offsets_[c]], ..., colored_springs_[color_offsets_[c+1] - 1].
+         * The constrained nodes are grouped the same way (a node constrained twice
+         * gets two colors) and processed after the springs. */
+        void setup_spring_coloring() {
+            std::vector<std::vector<bool>> used(n_unknowns() / 2 + 1);
+            auto first_free_color = [](const std::vector<bool>& _u0, const std::vector<bool>& _u1) {
+                size_t c = 0;
+                while((c < _u0.size() && _u0[c]) || (c < _u1.size() && _u1[c]))
+                    ++c;
+                return static_cast<int>(c);
+            };
+            auto mark = [](std::vector<bool>& _u, const int _c) {
+                if(_u.size() <= size_t(_c))
+                    _u.resize(_c + 1, false);
+                _u[_c] = true;
+            };
+
+            spring_colors_.resize(i0_.size());
+            for(size_t i = 0; i < i0_.size(); ++i) {
+                const int c = first_free_color(used[i0_[i]], used[i1_[i]]);
+                mark(used[i0_[i]], c);
+                mark(used[i1_[i]], c);
+                spring_colors_[i] = c;
+            }
+            group_by_color(spring_colors_, color_offsets_, colored_springs_);
+            colored_i0_.resize(i0_.size());
+            colored_i1_.resize(i0_.size());
+            colored_ks_.resize(i0_.size());
+            colored_ls_.resize(i0_.size());
+            for(size_t j = 0; j < i0_.size(); ++j) {
+                const int i = colored_springs_[j];
+                colored_i0_[j] = i0_[i];
+                colored_i1_[j] = i1_[i];
+                colored_ks_[j] = ks_[i];
+                colored_ls_[j] = ls_[i];
+            }
+
+            // constrained nodes
+            for(auto& u : used)
+                u.clear();
+            std::vector<int> cs_colors(attached_node_indices_.size());
+            for(size_t i = 0; i < attached_node_indices_.size(); ++i) {
+                const int c = first_free_color(used[attached_node_indices_[i]], std::vector<bool>());
+                mark(used[attached_node_indices_[i]], c);
+                cs_colors[i] = c;
+            }
+            group_by_color(cs_colors, cs_color_offsets_, colored_cs_);
+
+            spring_coloring_valid_ = true;
+        }
+
+        // counting sort of the element indices by color
+        static void group_by_color(const std::vector<int>& _colors, std::vector<int>& _offsets, std::vector<int>& _elements) {
+            int n_colors = 0;
+            for(int c : _colors)
+                n_colors = std::max(n_colors, c + 1);
+
+            _offsets.assign(n_colors + 1, 0);
+            for(int c : _colors)
+                ++_offsets[c + 1];
+            for(int c = 0; c < n_colors; ++c)
+                _offsets[c + 1] += _offsets[c];
+
+            std::vector<int> pos(_offsets.begin(), _offsets.end() - 1);
+            _elements.resize(_colors.size());
+            for(size_t i = 0; i < _colors.size(); ++i)
+                _elements[pos[_colors[i]]++] = static_cast<int>(i);
+        }
+
+        // number of energy terms, i.e. springs and constrained nodes
+        size_t n_energy_terms() const {
+            return i0_.size() + attached_node_indices_.size();
+        }
+
+        /** sequential sum of the energy terms [_begin, _end), the terms being the
+         * springs followed by the constrained nodes
+         * \param _xe, _coeff, _cs_xe, _cs_coeff buffers for the element coordinates and coefficients */
+        double eval_f_range(const Vec &_x, const size_t _begin, const size_t _end,
+                            Vec& _xe, Vec& _coeff, Vec& _cs_xe, Vec& _cs_coeff) {
+            double energy = 0;
+
+            //------------------------------------------------------//
+            // TODO: (done!) assemble function values of all spring elements
+            // use vector xe_ to store the local coordinates of two nodes of every spring
+            // then pass it to func_.eval_f(...)
+            const size_t spring_end = std::min(_end, i0_.size());
+            for(size_t i = _begin; i < spring_end; ++i) {
+                _xe[0] = _x[2 * i0_[i]];
+                _xe[1] = _x[2 * i0_[i] + 1];
+                _xe[2] = _x[2 * i1_[i]];
+                _xe[3] = _x[2 * i1_[i] + 1];
+
+                _coeff[0] = ks_[i];
+                _coeff[1] = ls_[i];
+
+                energy += func_.eval_f(_xe, _coeff);
+            }
+            //------------------------------------------------------//
+
+            //------------------------------------------------------//
+            // TODO: (done!) assemble function values of all the constrained spring elements
+            // use cs_xe_ to store the coordinate of the attached node index
+            // and cse_ to compute the attached node's functions
+            //cs_coeff = (weight, desired point x, desired point y)
+            const size_t cs_end = std::max(_end, i0_.size()) - i0_.size();
+            for(size_t i = std::max(_begin, i0_.size()) - i0_.size(); i < cs_end; ++i) {
+                _cs_xe[0] = _x[2 * attached_node_indices_[i]];
+                _cs_xe[1] = _x[2 * attached_node_indices_[i] + 1];
+
+                _cs_coeff[0] = weights_[i];
+                _cs_coeff[1] = desired_points_[2 * i];
+                _cs_coeff[2] = desired_points_[2 * i + 1];
+
+                energy += cse_.eval_f(_cs_xe, _cs_coeff);
+            }
+            //------------------------------------------------------//
+
+            return energy;
+        }
+
+        /** Gradient assembly of eval_gradient/eval_f_and_gradient following the spring
+         * coloring, on n_threads_ threads, see set_n_threads.
+         * _g should be sized and zeroed. Each thread has its own element buffers.
+         * The energy of each term is stored and then reduced with the chunks of eval_f,
+         * so that it does not depend on the coloring nor on the number of threads.
+         * \return the energy if WithEnergy, 0 otherwise */
+        template<bool WithEnergy>
+        double assemble_gradient_colored(const Vec &_x, Vec &_g) {
+            if(!spring_coloring_valid_)
+                setup_spring_coloring();
+
+            const int n_colors = static_cast<int>(color_offsets_.size()) - 1;
+            const int n_cs_colors = static_cast<int>(cs_color_offsets_.size()) - 1;
+            const size_t n_springs = i0_.size();
+            const size_t n_terms = n_energy_terms();
+            const size_t n_chunks = ReproducibleSum::n_chunks(n_terms);
+            if(WithEnergy) {
+                term_energy_.resize(n_terms);
+                chunk_energy_.resize(n_chunks);
+            }
+
+#pragma omp parallel num_threads(n_threads_) if(n_threads_ > 1)
+            {
+                ThreadBuffers& b = thread_buffers_[thread_index()];
+                Vec &xe = b.xe, &ge = b.ge, &coeff = b.coeff;
+                Vec &cs_xe = b.cs_xe, &cs_ge = b.cs_ge, &cs_coeff = b.cs_coeff;
+
+                for(int c = 0; c < n_colors; ++c) {
+#pragma omp for schedule(static)
+                    for(int j = color_offsets_[c]; j < color_offsets_[c + 1]; ++j) {
+                        const int i = colored_springs_[j];
+                        xe[0] = _x[2 * i0_[i]];
+                        xe[1] = _x[2 * i0_[i] + 1];
+                        xe[2] = _x[2 * i1_[i]];
+                        xe[3] = _x[2 * i1_[i] + 1];
+
+                        coeff[0] = ks_[i];
+                        coeff[1] = ls_[i];
+
+                        if(WithEnergy)
+                            term_energy_[i] = func_.eval_f_and_gradient(xe, coeff, ge);
+                        else
+                            func_.eval_gradient(xe, coeff, ge);
+
+                        _g[2 * i0_[i]] += ge[0];
+                        _g[2 * i0_[i] + 1] += ge[1];
+                        _g[2 * i1_[i]] += ge[2];
+                        _g[2 * i1_[i] + 1] += ge[3];
+                    }
+                }
+
+                for(int c = 0; c < n_cs_colors; ++c) {
+#pragma omp for schedule(static)
+                    for(int j = cs_color_offsets_[c]; j < cs_color_offsets_[c + 1]; ++j) {
+                        const int i = colored_cs_[j];
+                        cs_xe[0] = _x[2 * attached_node_indices_[i]];
+                        cs_xe[1] = _x[2 * attached_node_indices_[i] + 1];
+
+                        cs_coeff[0] = weights_[i];
+                        cs_coeff[1] = desired_points_[2 * i];
+                        cs_coeff[2] = desired_points_[2 * i + 1];
+
+                        if(WithEnergy)
+                            term_energy_[n_springs + i] = cse_.eval_f_and_gradient(cs_xe, cs_coeff, cs_ge);
+                        else
+                            cse_.eval_gradient(cs_xe, cs_coeff, cs_ge);
+
+                        _g[2 * attached_node_indices_[i]] += cs_ge[0];
+                        _g[2 * attached_node_indices_[i] + 1] += cs_ge[1];
+                    }
+                }
+
+                if(WithEnergy) {
+#pragma omp for schedule(static)
+                    for(int c = 0; c < int(n_chunks); ++c) {
+                        double energy = 0;
+                        const size_t end = ReproducibleSum::chunk_begin(c + 1, n_terms);
+                        for(size_t i = ReproducibleSum::chunk_begin(c, n_terms); i < end; ++i)
+                            energy += term_energy_[i];
+                        chunk_energy_[c] = energy;
+                    }
+                }
+            }
+
+            return WithEnergy ? ReproducibleSum::pairwise_sum(chunk_energy_) : 0.;
+        }
+
+        /** Hessian assembly of eval_hessian following the spring coloring, on n_threads_
+         * threads, see set_n_threads.
+         * Springs of the same color share no node, hence they write to disjoint
+         * slots of the cached pattern, and so do the constrained nodes of a color.
+         * _values should be the zeroed values of a matrix with the cached pattern. */
+        void assemble_hessian_colored(const Vec &_x, double* _values) {
+            if(!spring_coloring_valid_)
+                setup_spring_coloring();
+
+            const int n_colors = static_cast<int>(color_offsets_.size()) - 1;
+            const int n_cs_colors = static_cast<int>(cs_color_offsets_.size()) - 1;
+
+#pragma omp parallel num_threads(n_threads_) if(n_threads_ > 1)
+            {
+                ThreadBuffers& b = thread_buffers_[thread_index()];
+                Vec &xe = b.xe, &coeff = b.coeff, &cs_xe = b.cs_xe, &cs_coeff = b.cs_coeff;
+                Mat &he = b.he, &cs_he = b.cs_he;
+
+                for(int c = 0; c < n_colors; ++c) {
+#pragma omp for schedule(static)
+                    for(int j = color_offsets_[c]; j < color_offsets_[c + 1]; ++j) {
+                        const int i = colored_springs_[j];
+                        xe[0] = _x[2 * i0_[i]];
+                        xe[1] = _x[2 * i0_[i] + 1];
+                        xe[2] = _x[2 * i1_[i]];
+                        xe[3] = _x[2 * i1_[i] + 1];
+
+                        coeff[0] = ks_[i];
+                        coeff[1] = ls_[i];
+
+                        func_.eval_hessian(xe, coeff, he);
+
+                        const int* slots = &spring_slots_[16 * i];
+                        for(int k = 0; k < 16; ++k)
+                            _values[slots[k]] += he.data()[k];
+                    }
+                }
+
+                for(int c = 0; c < n_cs_colors; ++c) {
+#pragma omp for schedule(static)
+                    for(int j = cs_color_offsets_[c]; j < cs_color_offsets_[c + 1]; ++j) {
+                        const int i = colored_cs_[j];
+                        cs_xe[0] = _x[2 * attached_node_indices_[i]];
+                        cs_xe[1] = _x[2 * attached_node_indices_[i] + 1];
+
+                        cs_coeff[0] = weights_[i];
+                        cs_coeff[1] = desired_points_[2 * i];
+                        cs_coeff[2] = desired_points_[2 * i + 1];
+
+                        cse_.eval_hessian(cs_xe, cs_coeff, cs_he);
+
+                        const int* slots = &cs_slots_[4 * i];
+                        for(int k = 0; k < 4; ++k)
+                            _values[slots[k]] += cs_he.data()[k];
+                    }
+                }
+            }
+        }
+
+        // element buffers of a thread of the multithreaded evaluations
+        struct ThreadBuffers {
+            Vec xe, ge, coeff;
+            Mat he;
+            Vec cs_xe, cs_ge, cs_coeff;
+            Mat cs_he;
+        };
+
+        // makes sure that there are buffers for at least _n threads
+        void reserve_thread_buffers(const int _n) {
+            while(int(thread_buffers_.size()) < _n) {
+                thread_buffers_.emplace_back();
+                ThreadBuffers& b = thread_buffers_.back();
+                b.xe.resize(func_.n_unknowns());
+                b.ge.resize(func_.n_unknowns());
+                b.coeff.resize(2);
+                b.he.resize(func_.n_unknowns(), func_.n_unknowns());
+                b.cs_xe.resize(cse_.n_unknowns());
+                b.cs_ge.resize(cse_.n_unknowns());
+                b.cs_coeff.resize(3);
+                b.cs_he.resize(cse_.n_unknowns(), cse_.n_unknowns());
+            }
+        }
+
+        // index of the calling thread in the current parallel region
+        static int thread_index() {
+#ifdef _OPENMP
+            return omp_get_thread_num();
+#else
+            return 0;
+#endif
+        }
+
+        /** Symbolic phase of the Hessian assembly.
+         * Builds the compressed sparsity pattern of the Hessian from the current
+         * topology and stores, for each spring (resp. constrained node), the offsets
+         * into valuePtr() of its 16 (resp. 4) local Hessian entries in column-major order. */
+        void setup_hessian_pattern() {
+            std::vector<T> triplets;
+            triplets.reserve(16 * i0_.size() + 4 * attached_node_indices_.size());
+
+            for(size_t i=0; i<i0_.size(); ++i) {
+                const int ids[4] = {2 * i0_[i], 2 * i0_[i] + 1,
+                                    2 * i1_[i], 2 * i1_[i] + 1};
+                for(int c=0; c<4; ++c)
+                    for(int r=0; r<4; ++r)
+                        triplets.emplace_back(ids[r], ids[c], 0.);
+            }
+
+            for(size_t i=0; i<attached_node_indices_.size(); ++i) {
+                const int ids[2] = {2 * attached_node_indices_[i], 2 * attached_node_indices_[i] + 1};
+                for(int c=0; c<2; ++c)
+                    for(int r=0; r<2; ++r)
+                        triplets.emplace_back(ids[r], ids[c], 0.);
+            }
+
+            hessian_pattern_.resize(n_unknowns(), n_unknowns());
+            hessian_pattern_.setFromTriplets(triplets.begin(), triplets.end());
+            hessian_pattern_.makeCompressed();
+
+            // triplets were generated in the same order as the local entries
+            spring_slots_.resize(16 * i0_.size());
+            for(size_t i=0; i<spring_slots_.size(); ++i)
+                spring_slots_[i] = hessian_slot(triplets[i].row(), triplets[i].col());
+
+            const size_t offset = spring_slots_.size();
+            cs_slots_.resize(4 * attached_node_indices_.size());
+            for(size_t i=0; i<cs_slots_.size(); ++i)
+                cs_slots_[i] = hessian_slot(triplets[offset + i].row(), triplets[offset + i].col());
+
+            hessian_pattern_valid_ = true;
+        }
+
+        // offset of the entry (_row, _col) in hessian_pattern_.valuePtr()
+        int hessian_slot(const int _row, const int _col) const {
+            const int* inner = hessian_pattern_.innerIndexPtr();
+            const int* begin = inner + hessian_pattern_.outerIndexPtr()[_col];
+            const int* end = inner + hessian_pattern_.outerIndexPtr()[_col + 1];
+            return static_cast<int>(std::lower_bound(begin, end, _row) - inner);
+        }
+
+        // true if _h has exactly the compressed structure of hessian_pattern_
+        bool has_hessian_pattern(const SMat& _h) const {
+            if(_h.rows() != hessian_pattern_.rows() || _h.cols() != hessian_pattern_.cols()
+               || !_h.isCompressed() || _h.nonZeros() != hessian_pattern_.nonZeros())
+                return false;
+
+            const int n_outer = hessian_pattern_.outerSize() + 1;
+            return std::equal(_h.outerIndexPtr(), _h.outerIndexPtr() + n_outer, hessian_pattern_.outerIndexPtr())
+                   && std::equal(_h.innerIndexPtr(), _h.innerIndexPtr() + _h.nonZeros(), hessian_pattern_.innerIndexPtr());
+        }
+
+    protected:
         int n_;
-        std::vector<Edge> springs_;
+        // springs stored as structure of arrays, the i-th spring connects the
+        // nodes i0_[i] and i1_[i] with the coefficients ks_[i] and ls_[i]
+        std::vector<int> i0_;
+        std::vector<int> i1_;
         ParametricFunctionBase& func_;
         std::vector<double> ks_;
         std::vector<double> ls_;
         Vec xe_;
-        Vec ge_;
+        // element direction, for line_polynomial
+        Vec de_;
         Mat he_;
         std::vector<int> attached_node_indices_;
         ConstrainedSpringElement2D cse_;
         std::vector<double> weights_;
         std::vector<double> desired_points_;
         Vec cs_xe_;
-        Vec cs_ge_;
-        Mat cs_he_;
+        Vec cs_de_;
+        // element coefficients (k, l) and (weight, desired point x, desired point y)
+        Vec coeff_;
+        Vec cs_coeff_;
+
+        // cached Hessian structure, invalidated whenever the topology changes
+        bool hessian_pattern_valid_ = false;
+        SMat hessian_pattern_;
+        std::vector<int> spring_slots_;
+        std::vector<int> cs_slots_;
+
+        // threads used for the gradient, and the cached spring coloring allowing
+        // to process springs in parallel, invalidated whenever the topology changes
+        int n_threads_ = 1;
+        // element buffers of each thread, see reserve_thread_buffers
+        std::vector<ThreadBuffers> thread_buffers_;
+        bool spring_coloring_valid_ = false;
+        std::vector<int> spring_colors_;
+        std::vector<int> color_offsets_;
+        std::vector<int> colored_springs_;
+        // the springs' nodes and coefficients in the colored order, for the SIMD kernels
+        std::vector<int> colored_i0_, colored_i1_;
+        std::vector<double> colored_ks_, colored_ls_;
+        std::vector<int> cs_color_offsets_;
+        std::vector<int> colored_cs_;
+
+        // energy of each term (colored path only) and of each chunk, see ReproducibleSum
+        std::vector<double> term_energy_;
+        std::vector<double> chunk_energy_;
     };
 }
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <Functions/MassSpringProblem2DSparse.hh>
+#include <Functions/ConstrainedSpringElement2D.hh>
+#include <Functions/SpringKernelsSIMD.hh>
+#include <typeinfo>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+//== CLASS DEFINITION =========================================================
+
+    /* Statically-dispatched version of MassSpringProblem2DSparse.
+     *
+     * The spring element type is a template parameter instead of a
+     * ParametricFunctionBase reference, and the per-spring computations go through
+     * the element's static fixed-size kernels (Eigen::Vector4d/Matrix4d, coefficients
+     * passed as scalars) instead of virtual calls on heap-backed vectors.
+     * This lets the compiler inline the element into the assembly loops.
+     *
+     * Element must provide
+     *   static double f(const Vector4d& x, double k, double l)
+     *   static double f_and_gradient(const Vector4d& x, double k, double l, Vector4d& g)
+     *   static void hessian(const Vector4d& x, double k, double l, Matrix4d& H)
+     * as done by SpringElement2D and SpringElement2DWithLength.
+     * The constrained nodes always use the kernels of ConstrainedSpringElement2D.
+     *
+     * For SpringElement2D and SpringElement2DWithLength, energy and gradient are
+     * evaluated by the AVX2/AVX-512 kernels of SpringKernelsSIMD when the CPU supports
+     * them, the scalar loop only handling the remaining springs. The energy goes over
+     * the springs in order, the gradient over the blocks of each color of the spring
+     * coloring, with any number of threads (see set_n_threads), so that both are
+     * bitwise identical for any number of threads.
+     *
+     * The topology (springs, constrained nodes, cached Hessian pattern) is the
+     * one of MassSpringProblem2DSparse, which stays available for custom elements
+     * that only implement the ParametricFunctionBase interface. */
+    template<class Element>
+    class MassSpringProblem2DSparseT : public MassSpringProblem2DSparse {
+    public:
+        using Vec = MassSpringProblem2DSparse::Vec;
+        using SMat = MassSpringProblem2DSparse::SMat;
+        using Vec2 = Eigen::Vector2d;
+        using Vec4 = Eigen::Vector4d;
+        using Mat4 = Eigen::Matrix4d;
+
+        /** Same signature as MassSpringProblem2DSparse so that it can be used by
+         * MassSpringSystemT. _spring should be an Element, it is only used to check
+         * that the system set up the expected spring type */
+        MassSpringProblem2DSparseT(ParametricFunctionBase& _spring, const int _n_unknowns) :
+                MassSpringProblem2DSparse(_spring, _n_unknowns),
+                simd_isa_(Traits::available ? SpringKernelsSIMD::detected_isa() : SpringKernelsSIMD::SCALAR) {
+            if(typeid(_spring) != typeid(Element))
+                std::cout << "Warning: MassSpringProblem2DSparseT was set up with a spring element "
+                             "that differs from its template parameter, the latter will be used!" << std::endl;
+        }
+
+        ~MassSpringProblem2DSparseT() {}
+
+        // instruction set used for the spring energy and gradient
+        SpringKernelsSIMD::Isa simd_isa() const { return simd_isa_; }
+
+        /** selects the instruction set, e.g. to compare against the scalar path.
+         * Sets that are not supported by the CPU or the element fall back to the best available one */
+        void set_simd_isa(const SpringKernelsSIMD::Isa _isa) {
+            if(!Traits::available)
+                simd_isa_ = SpringKernelsSIMD::SCALAR;
+            else
+                simd_isa_ = std::min(_isa, SpringKernelsSIMD::detected_isa());
+        }
+
+        virtual double eval_f(const Vec &_x) override {
+            const size_t n_terms = n_energy_terms();
+            const size_t n_chunks = ReproducibleSum::n_chunks(n_terms);
+            if(n_chunks <= 1)
+                return kernel_f_range(_x, 0, n_terms);
+
+            chunk_energy_.resize(n_chunks);
+#pragma omp parallel for num_threads(n_threads_) schedule(static) if(n_threads_ > 1)
+            for(int c = 0; c < int(n_chunks); ++c)
+                chunk_energy_[c] = kernel_f_range(_x, ReproducibleSum::chunk_begin(c, n_terms),
+                                                  ReproducibleSum::chunk_begin(c + 1, n_terms));
+
+            return ReproducibleSum::pairwise_sum(chunk_energy_);
+        }
+
+        // same energy as eval_f, see MassSpringProblem2DSparse::eval_f_concurrent;
+        // the kernels need no work storage, hence no slot
+        virtual double eval_f_concurrent(const Vec &_x, const int /*_slot*/) override {
+            const size_t n_terms = n_energy_terms();
+            return ReproducibleSum::pairwise_sum_of_chunks([&](const size_t _c) {
+                return kernel_f_range(_x, ReproducibleSum::chunk_begin(_c, n_terms),
+                                      ReproducibleSum::chunk_begin(_c + 1, n_terms));
+            }, 0, std::max<size_t>(ReproducibleSum::n_chunks(n_terms), 1));
+        }
+
+        virtual void eval_gradient(const Vec &_x, Vec &_g) override {
+            _g.resize(n_unknowns());
+            _g.setZero();
+            gradient_colored(_x, _g);
+        }
+
+        // the energy of the colored blocks does not sum up to the one of the chunks of
+        // eval_f, so the energy and the gradient are evaluated in two passes
+        virtual double eval_f_and_gradient(const Vec &_x, Vec &_g) override {
+            eval_gradient(_x, _g);
+            return eval_f(_x);
+        }
+
+        // matrix-free Hessian-vector product with the element's Hessian kernel,
+        // see MassSpringProblem2DSparse::eval_hessian_vector
+        virtual void eval_hessian_vector(const Vec &_x, const Vec &_v, Vec &_hv) override {
+            _hv.resize(n_unknowns());
+            _hv.setZero();
+
+            Vec4 xe, ve;
+            Mat4 he;
+            for(size_t i=0; i<i0_.size(); ++i) {
+                const int a = 2 * i0_[i], b = 2 * i1_[i];
+                xe << _x[a], _x[a + 1], _x[b], _x[b + 1];
+                ve << _v[a], _v[a + 1], _v[b], _v[b + 1];
+
+                Element::hessian(xe, ks_[i], ls_[i], he);
+                ve = he * ve;
+
+                _hv[a] += ve[0];
+                _hv[a + 1] += ve[1];
+                _hv[b] += ve[2];
+                _hv[b + 1] += ve[3];
+            }
+
+            for(size_t i = 0; i < attached_node_indices_.size(); ++i) {
+                const int a = 2 * attached_node_indices_[i];
+                _hv[a] += weights_[i] * _v[a];
+                _hv[a + 1] += weights_[i] * _v[a + 1];
+            }
+        }
+
+        virtual void eval_hessian(const Vec &_x, SMat &_h) override {
+            if(!hessian_pattern_valid_)
+                setup_hessian_pattern();
+
+            if(!has_hessian_pattern(_h))
+                _h = hessian_pattern_;
+
+            double* values = _h.valuePtr();
+            std::fill(values, values + _h.nonZeros(), 0.);
+
+            // the springs follow the coloring with any number of threads, see set_n_threads
+            hessian_colored(_x, values);
+        }
+
+    private:
+        // energy of the terms [_begin, _end), springs followed by constrained nodes, see eval_f_range
+        double kernel_f_range(const Vec &_x, const size_t _begin, const size_t _end) {
+            const size_t spring_end = std::min(_end, i0_.size());
+            double energy(0);
+            const size_t n_simd = _begin < spring_end ?
+                    SpringKernelsSIMD::energy(simd_isa_, Traits::with_length, _x.data(),
+                                              i0_.data() + _begin, i1_.data() + _begin, ks_.data() + _begin, ls_.data() + _begin,
+                                              spring_end - _begin, energy) : 0;
+            for(size_t i = _begin + n_simd; i < spring_end; ++i) {
+                const int a = 2 * i0_[i];
+                const int b = 2 * i1_[i];
+                energy += Element::f(Vec4(_x[a], _x[a + 1], _x[b], _x[b + 1]), ks_[i], ls_[i]);
+            }
+
+            const size_t cs_end = std::max(_end, i0_.size()) - i0_.size();
+            for(size_t i = std::max(_begin, i0_.size()) - i0_.size(); i < cs_end; ++i) {
+                const int a = 2 * attached_node_indices_[i];
+                energy += ConstrainedSpringElement2D::f(Vec2(_x[a], _x[a + 1]), weights_[i],
+                                                        desired_points_[2 * i], desired_points_[2 * i + 1]);
+            }
+
+            return energy;
+        }
+
+        /** gradient following the spring coloring on n_threads_ threads, see set_n_threads.
+         * Each color is split into blocks of gradient_block_size springs, each going through
+         * the SIMD kernel and the scalar loop for its remaining springs, so that each spring
+         * is evaluated by the same kernel with any number of threads. _g should be zeroed */
+        void gradient_colored(const Vec &_x, Vec &_g) {
+            if(!spring_coloring_valid_)
+                setup_spring_coloring();
+
+            const int n_colors = static_cast<int>(color_offsets_.size()) - 1;
+            const int n_cs_colors = static_cast<int>(cs_color_offsets_.size()) - 1;
+
+#pragma omp parallel num_threads(n_threads_) if(n_threads_ > 1)
+            {
+                Vec4 ge;
+                Vec2 cs_ge;
+
+                for(int c = 0; c < n_colors; ++c) {
+                    const int n_blocks = (color_offsets_[c + 1] - color_offsets_[c] + gradient_block_size - 1) / gradient_block_size;
+#pragma omp for schedule(static)
+                    for(int k = 0; k < n_blocks; ++k) {
+                        const size_t begin = color_offsets_[c] + k * gradient_block_size;
+                        const size_t end = std::min<size_t>(begin + gradient_block_size, color_offsets_[c + 1]);
+                        // the energy of the block is not needed
+                        double energy;
+                        const size_t n_simd = SpringKernelsSIMD::energy_and_gradient(simd_isa_, Traits::with_length, _x.data(),
+                                                                                     colored_i0_.data() + begin, colored_i1_.data() + begin,
+                                                                                     colored_ks_.data() + begin, colored_ls_.data() + begin,
+                                                                                     end - begin, energy, _g.data());
+                        for(size_t j = begin + n_simd; j < end; ++j) {
+                            const int a = 2 * colored_i0_[j];
+                            const int b = 2 * colored_i1_[j];
+                            Element::f_and_gradient(Vec4(_x[a], _x[a + 1], _x[b], _x[b + 1]), colored_ks_[j], colored_ls_[j], ge);
+
+                            _g[a] += ge[0];
+                            _g[a + 1] += ge[1];
+                            _g[b] += ge[2];
+                            _g[b + 1] += ge[3];
+                        }
+                    }
+                }
+
+                for(int c = 0; c < n_cs_colors; ++c) {
+#pragma omp for schedule(static)
+                    for(int j = cs_color_offsets_[c]; j < cs_color_offsets_[c + 1]; ++j) {
+                        const int i = colored_cs_[j];
+                        const int a = 2 * attached_node_indices_[i];
+                        ConstrainedSpringElement2D::f_and_gradient(Vec2(_x[a], _x[a + 1]), weights_[i],
+                                                                   desired_points_[2 * i], desired_points_[2 * i + 1], cs_ge);
+                        _g[a] += cs_ge[0];
+                        _g[a + 1] += cs_ge[1];
+                    }
+                }
+            }
+        }
+
+        // Hessian assembly following the spring coloring, see assemble_hessian_colored
+        void hessian_colored(const Vec &_x, double* _values) {
+            if(!spring_coloring_valid_)
+                setup_spring_coloring();
+
+            const int n_colors = static_cast<int>(color_offsets_.size()) - 1;
+            const int n_cs_colors = static_cast<int>(cs_color_offsets_.size()) - 1;
+
+#pragma omp parallel num_threads(n_threads_) if(n_threads_ > 1)
+            {
+                Mat4 he;
+
+                for(int c = 0; c < n_colors; ++c) {
+#pragma omp for schedule(static)
+                    for(int j = color_offsets_[c]; j < color_offsets_[c + 1]; ++j) {
+                        const int i = colored_springs_[j];
+                        const int a = 2 * i0_[i];
+                        const int b = 2 * i1_[i];
+                        Element::hessian(Vec4(_x[a], _x[a + 1], _x[b], _x[b + 1]), ks_[i], ls_[i], he);
+
+                        const int* slots = &spring_slots_[16 * i];
+                        for(int k = 0; k < 16; ++k)
+                            _values[slots[k]] += he.data()[k];
+                    }
+                }
+
+                for(int c = 0; c < n_cs_colors; ++c) {
+#pragma omp for schedule(static)
+                    for(int j = cs_color_offsets_[c]; j < cs_color_offsets_[c + 1]; ++j) {
+                        const int i = colored_cs_[j];
+                        const int* slots = &cs_slots_[4 * i];
+                        _values[slots[0]] += weights_[i];
+                        _values[slots[3]] += weights_[i];
+                    }
+                }
+            }
+        }
+
+        using Traits = SpringKernelSIMDTraits<Element>;
+
+        // springs per block of gradient_colored, a multiple of the SIMD widths
+        static const int gradient_block_size = 256;
+
+        SpringKernelsSIMD::Isa simd_isa_;
+    };
+
+//=============================================================================
+}
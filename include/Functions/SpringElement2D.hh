@@ -1,6 +1,7 @@
 #pragma once
 
 #include <FunctionBase/ParametricFunctionBase.hh>
+#include <FunctionBase/ParametricResidualBase.hh>
 
 //== NAMESPACES ===============================================================
 
@@ -11,9 +12,13 @@ namespace AOPT {
     /* This function evaluates the energy of an ideal spring with no length
      * going from x_a to x_b.
      * It is a Parametric Function because it requires the elastic constant
-     * parameter k_ab for the energy computation. */
-    class SpringElement2D : public ParametricFunctionBase {
+     * parameter k_ab for the energy computation.
+     * Its residual form is r = sqrt(k) * (x_a - x_b). */
+    class SpringElement2D : public ParametricFunctionBase, public ParametricResidualBase {
     public:
+        using Vec = ParametricFunctionBase::Vec;
+        using Mat = ParametricFunctionBase::Mat;
+
         // E_ab(x) = 1/2 * k * ((x[0] - x[2])^2 + (x[1] - x[3])^2)
         // constructor
         SpringElement2D() : ParametricFunctionBase() {}
@@ -54,6 +59,23 @@ namespace AOPT {
             //------------------------------------------------------//
         }
 
+        /** evaluates the spring element's energy and its gradient at once
+         * \param _x contains x_a and x_b contiguously
+         * \param _coeffs stores the constant k
+         * \param _g the output gradient, which should also be of dimension 4
+         * \return the energy of the spring */
+        inline virtual double eval_f_and_gradient(const Vec &_x, const Vec &_coeffs, Vec &_g) override {
+            double dx = _x[0] - _x[2];
+            double dy = _x[1] - _x[3];
+
+            _g[0] = _coeffs[0] * dx;
+            _g[1] = _coeffs[0] * dy;
+            _g[2] = -_g[0];
+            _g[3] = -_g[1];
+
+            return 0.5 * _coeffs[0] * (dx*dx + dy*dy);
+        }
+
 
         /** evaluates the spring element's energy Hessian
          * \param _x contains x_a and x_b contiguously,
@@ -71,6 +93,69 @@ namespace AOPT {
             
             //------------------------------------------------------//
         }
+
+        /** the energy along _x + t _d, 1/2 k |u + t v|^2 with u = x_a - x_b and v = d_a - d_b,
+         * is of degree 2
+         * \param _p the output coefficients, by increasing degree */
+        inline virtual bool line_polynomial(const Vec &_x, const Vec &_d, const Vec &_coeffs, double _p[5]) override {
+            const double ux = _x[0] - _x[2], uy = _x[1] - _x[3];
+            const double vx = _d[0] - _d[2], vy = _d[1] - _d[3];
+            _p[0] = 0.5 * _coeffs[0] * (ux * ux + uy * uy);
+            _p[1] = _coeffs[0] * (ux * vx + uy * vy);
+            _p[2] = 0.5 * _coeffs[0] * (vx * vx + vy * vy);
+            _p[3] = _p[4] = 0.;
+            return true;
+        }
+
+        // number of residuals
+        inline virtual int n_residuals() override { return 2; }
+
+        /** evaluates the residuals r = sqrt(k) * (x_a - x_b)
+         * \param _x contains x_a and x_b contiguously
+         * \param _coeffs stores the constant k
+         * \param _r the output residuals, of dimension 2 */
+        inline virtual void eval_residual(const Vec &_x, const Vec &_coeffs, Vec &_r) override {
+            const double sk = std::sqrt(_coeffs[0]);
+            _r[0] = sk * (_x[0] - _x[2]);
+            _r[1] = sk * (_x[1] - _x[3]);
+        }
+
+        /** evaluates the Jacobian of the residuals, sqrt(k) * [I -I]
+         * \param _x contains x_a and x_b contiguously
+         * \param _coeffs stores the constant k
+         * \param _J the output Jacobian, which should be a 2x4 Matrix */
+        inline virtual void eval_jacobian(const Vec &/*_x*/, const Vec &_coeffs, Mat &_J) override {
+            const double sk = std::sqrt(_coeffs[0]);
+            _J << sk, 0, -sk, 0,
+                  0, sk, 0, -sk;
+        }
+
+        /* Fixed-size kernels of the functions above, taking the coefficients as scalars.
+         * They are used by MassSpringProblem2DSparseT, where they can be inlined
+         * into the assembly loops since there is neither a virtual call nor a heap vector.
+         * _l is unused and only there to share the signature of SpringElement2DWithLength. */
+        using Vec4 = Eigen::Vector4d;
+        using Mat4 = Eigen::Matrix4d;
+
+        static inline double f(const Vec4 &_x, const double _k, const double /*_l*/) {
+            double dx = _x[0] - _x[2];
+            double dy = _x[1] - _x[3];
+            return 0.5 * _k * (dx*dx + dy*dy);
+        }
+
+        static inline double f_and_gradient(const Vec4 &_x, const double _k, const double /*_l*/, Vec4 &_g) {
+            double dx = _x[0] - _x[2];
+            double dy = _x[1] - _x[3];
+            _g << _k * dx, _k * dy, -_k * dx, -_k * dy;
+            return 0.5 * _k * (dx*dx + dy*dy);
+        }
+
+        static inline void hessian(const Vec4 &/*_x*/, const double _k, const double /*_l*/, Mat4 &_H) {
+            _H << _k, 0, -_k, 0,
+                  0, _k, 0, -_k,
+                  -_k, 0, _k, 0,
+                  0, -_k, 0, _k;
+        }
     };
 
 //=============================================================================
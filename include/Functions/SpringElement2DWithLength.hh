@@ -1,6 +1,7 @@
 #pragma once
 
 #include <FunctionBase/ParametricFunctionBase.hh>
+#include <FunctionBase/ParametricResidualBase.hh>
 
 //== NAMESPACES ===============================================================
 
@@ -11,9 +12,13 @@ namespace AOPT {
 
 /* This class evaluates the energy with a spring with length.
  * It is very similar to the SpringElement2D except it has an addition parameter
- * l_ab which represents the length of the spring at rest. */
-    class SpringElement2DWithLength : public ParametricFunctionBase {
+ * l_ab which represents the length of the spring at rest.
+ * Its residual form is the single residual r = sqrt(k) * (|x_a - x_b|^2 - l^2). */
+    class SpringElement2DWithLength : public ParametricFunctionBase, public ParametricResidualBase {
     public:
+        using Vec = ParametricFunctionBase::Vec;
+        using Mat = ParametricFunctionBase::Mat;
+
         // E'_ab(x) = 1/2 * k * (((x[0] - x[2])^2 + (x[1] - x[3])^2) - l^2)^2
         // constructor
         SpringElement2DWithLength() : ParametricFunctionBase() {}
@@ -56,6 +61,26 @@ namespace AOPT {
             //------------------------------------------------------//
         }
 
+        /** evaluates the spring element's energy and its gradient at once,
+         * sharing the squared length term between both
+         * \param _x contains x_a and x_b contiguously
+         * \param _coeffs stores the constants k and l
+         * \param _g the output gradient, which should also be of dimension 4
+         * \return the energy of the spring */
+        inline virtual double eval_f_and_gradient(const Vec &_x, const Vec &_coeffs, Vec &_g) override {
+            double dx = _x[0] - _x[2];
+            double dy = _x[1] - _x[3];
+            double r = dx*dx + dy*dy - _coeffs[1]*_coeffs[1];
+
+            double part = 2.0 * _coeffs[0] * r;
+            _g[0] = part * dx;
+            _g[1] = part * dy;
+            _g[2] = -_g[0];
+            _g[3] = -_g[1];
+
+            return 0.5 * _coeffs[0] * r * r;
+        }
+
         /** evaluates the spring element's energy Hessian
          * \param _x contains x_a and x_b contiguously,
          *           i.e. _x = [x_a, x_b], i.e. _x is of dimension 4
@@ -89,6 +114,85 @@ namespace AOPT {
             
             //------------------------------------------------------//
         }
+
+        /** the energy along _x + t _d is 1/2 k s(t)^2, with
+         * s(t) = |u + t v|^2 - l^2 = a + b t + c t^2, u = x_a - x_b and v = d_a - d_b
+         * \param _p the output coefficients, by increasing degree */
+        inline virtual bool line_polynomial(const Vec &_x, const Vec &_d, const Vec &_coeffs, double _p[5]) override {
+            const double ux = _x[0] - _x[2], uy = _x[1] - _x[3];
+            const double vx = _d[0] - _d[2], vy = _d[1] - _d[3];
+            const double a = ux * ux + uy * uy - _coeffs[1] * _coeffs[1];
+            const double b = 2. * (ux * vx + uy * vy);
+            const double c = vx * vx + vy * vy;
+            const double hk = 0.5 * _coeffs[0];
+            _p[0] = hk * a * a;
+            _p[1] = hk * 2. * a * b;
+            _p[2] = hk * (b * b + 2. * a * c);
+            _p[3] = hk * 2. * b * c;
+            _p[4] = hk * c * c;
+            return true;
+        }
+
+        // number of residuals
+        inline virtual int n_residuals() override { return 1; }
+
+        /** evaluates the residual r = sqrt(k) * (|x_a - x_b|^2 - l^2)
+         * \param _x contains x_a and x_b contiguously
+         * \param _coeffs stores the constants k and l
+         * \param _r the output residual, of dimension 1 */
+        inline virtual void eval_residual(const Vec &_x, const Vec &_coeffs, Vec &_r) override {
+            double dx = _x[0] - _x[2];
+            double dy = _x[1] - _x[3];
+            _r[0] = std::sqrt(_coeffs[0]) * (dx*dx + dy*dy - _coeffs[1]*_coeffs[1]);
+        }
+
+        /** evaluates the Jacobian of the residual, 2 sqrt(k) * [d^T -d^T] with d = x_a - x_b
+         * \param _x contains x_a and x_b contiguously
+         * \param _coeffs stores the constants k and l
+         * \param _J the output Jacobian, which should be a 1x4 Matrix */
+        inline virtual void eval_jacobian(const Vec &_x, const Vec &_coeffs, Mat &_J) override {
+            double part = 2.0 * std::sqrt(_coeffs[0]);
+            double dx = part * (_x[0] - _x[2]);
+            double dy = part * (_x[1] - _x[3]);
+            _J << dx, dy, -dx, -dy;
+        }
+
+        /* Fixed-size kernels of the functions above with scalar coefficients,
+         * used by MassSpringProblem2DSparseT (see SpringElement2D) */
+        using Vec4 = Eigen::Vector4d;
+        using Mat4 = Eigen::Matrix4d;
+
+        static inline double f(const Vec4 &_x, const double _k, const double _l) {
+            double dx = _x[0] - _x[2];
+            double dy = _x[1] - _x[3];
+            double r = dx*dx + dy*dy - _l*_l;
+            return 0.5 * _k * r * r;
+        }
+
+        static inline double f_and_gradient(const Vec4 &_x, const double _k, const double _l, Vec4 &_g) {
+            double dx = _x[0] - _x[2];
+            double dy = _x[1] - _x[3];
+            double r = dx*dx + dy*dy - _l*_l;
+            double part = 2.0 * _k * r;
+            _g << part * dx, part * dy, -part * dx, -part * dy;
+            return 0.5 * _k * r * r;
+        }
+
+        static inline void hessian(const Vec4 &_x, const double _k, const double _l, Mat4 &_H) {
+            double dx = _x[0] - _x[2];
+            double dy = _x[1] - _x[3];
+            double lsq = _l*_l;
+
+            // 2x2 block B, the full Hessian is [B -B; -B B]
+            double b00 = _k*(-2.0*lsq + 6.0*dx*dx + 2.0*dy*dy);
+            double b01 = 4.0*_k*dx*dy;
+            double b11 = _k*(-2.0*lsq + 2.0*dx*dx + 6.0*dy*dy);
+
+            _H << b00, b01, -b00, -b01,
+                  b01, b11, -b01, -b11,
+                  -b00, -b01, b00, b01,
+                  -b01, -b11, b01, b11;
+        }
     };
 
 //=============================================================================
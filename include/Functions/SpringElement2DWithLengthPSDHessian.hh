@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Functions/SpringElement2DWithLength.hh>
+#include <algorithm>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+
+//== CLASS DEFINITION =========================================================
+
+/* Same energy and gradient as SpringElement2DWithLength, but its Hessian is
+ * projected to the cone of positive semi-definite matrices.
+ *
+ * The Hessian of SpringElement2DWithLength is indefinite when the spring is
+ * compressed, so Newton's method on it does not give descent directions in general.
+ * With the projected Hessians, the assembled Hessian is positive semi-definite
+ * everywhere, i.e. it gives a convex local model (projected Newton).
+ *
+ * The projection is in closed form: with d = x_a - x_b and s = |d|^2, the Hessian
+ * is [B -B; -B B] with B = 2k ((s - l^2) I + 2 d d^T), whose eigenvalues are
+ * 2 * eig(B) and twice 0. B's eigenvectors are d, with eigenvalue 2k (3s - l^2),
+ * and d's orthogonal, with eigenvalue 2k (s - l^2). Clamping them to 0 gives the
+ * closest positive semi-definite matrix in Frobenius norm. */
+    class SpringElement2DWithLengthPSDHessian : public SpringElement2DWithLength {
+    public:
+        SpringElement2DWithLengthPSDHessian() : SpringElement2DWithLength() {}
+
+        /** evaluates the projected Hessian of the spring element's energy
+         * \param _x contains x_a and x_b contiguously
+         * \param _coeffs stores the constants k and l
+         * \param _H the output Hessian, which should be a 4x4 Matrix */
+        inline virtual void eval_hessian(const Vec &_x, const Vec &_coeffs, Mat &_H) override {
+            double b00, b01, b11;
+            projected_block(_x[0] - _x[2], _x[1] - _x[3], _coeffs[0], _coeffs[1], b00, b01, b11);
+
+            _H << b00, b01, -b00, -b01,
+                  b01, b11, -b01, -b11,
+                  -b00, -b01, b00, b01,
+                  -b01, -b11, b01, b11;
+        }
+
+        // fixed-size kernel, used by MassSpringProblem2DSparseT
+        static inline void hessian(const Vec4 &_x, const double _k, const double _l, Mat4 &_H) {
+            double b00, b01, b11;
+            projected_block(_x[0] - _x[2], _x[1] - _x[3], _k, _l, b00, b01, b11);
+
+            _H << b00, b01, -b00, -b01,
+                  b01, b11, -b01, -b11,
+                  -b00, -b01, b00, b01,
+                  -b01, -b11, b01, b11;
+        }
+
+    private:
+        // the projected 2x2 block B = lambda_d u u^T + lambda_o (I - u u^T), u = d / |d|
+        static inline void projected_block(const double _dx, const double _dy, const double _k, const double _l,
+                                           double& _b00, double& _b01, double& _b11) {
+            const double s = _dx*_dx + _dy*_dy;
+            const double lambda_o = std::max(0., 2.0*_k*(s - _l*_l));
+
+            if(s <= 0.) {
+                // B = -2 k l^2 I
+                _b00 = _b11 = lambda_o;
+                _b01 = 0.;
+                return;
+            }
+
+            const double lambda_d = std::max(0., 2.0*_k*(3.0*s - _l*_l));
+            const double c = (lambda_d - lambda_o) / s;
+            _b00 = lambda_o + c*_dx*_dx;
+            _b01 = c*_dx*_dy;
+            _b11 = lambda_o + c*_dy*_dy;
+        }
+    };
+
+//=============================================================================
+}
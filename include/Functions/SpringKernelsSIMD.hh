@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstddef>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define AOPT_SPRING_SIMD_X86
+#include <immintrin.h>
+#endif
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    class SpringElement2D;
+    class SpringElement2DWithLength;
+    class SpringElement2DWithLengthPSDHessian;
+
+//== CLASS DEFINITION =========================================================
+
+    /* Explicit SIMD kernels evaluating the energy (and gradient) of many springs
+     * stored as structure of arrays, i.e. the i-th spring connects the nodes
+     * i0[i] and i1[i] and has the coefficients k[i] and l[i].
+     *
+     * The AVX2 kernels process 4 springs and the AVX-512 kernels 8 springs per
+     * instruction: node positions are gathered from x, the energies are accumulated
+     * lane-wise and reduced at the end. Neighboring springs almost always share a
+     * node, so the gradient contributions are computed in SIMD registers but
+     * scattered to g in spring order, which avoids any write conflict.
+     *
+     * Both versions are compiled with function-level target attributes, so no
+     * special compiler flag is needed, and the best one supported by the running CPU
+     * is chosen at runtime. On other platforms only SCALAR is available, in which
+     * case the kernels process no spring at all.
+     *
+     * The kernels process the springs [0, n - n % W) where W is the SIMD width and
+     * return how many springs they processed, leaving the rest to the caller's
+     * scalar loop. */
+    class SpringKernelsSIMD {
+    public:
+        enum Isa {SCALAR, AVX2, AVX512};
+
+        // the best instruction set supported by the CPU, detected once
+        static Isa detected_isa() {
+            static const Isa isa = detect_isa();
+            return isa;
+        }
+
+        /** energy of the springs
+         * \param _with_length false for SpringElement2D, true for SpringElement2DWithLength
+         * \param _energy output energy of the processed springs
+         * \return the number of processed springs */
+        static size_t energy(const Isa _isa, const bool _with_length, const double* _x,
+                             const int* _i0, const int* _i1, const double* _k, const double* _l,
+                             const size_t _n, double& _energy) {
+            _energy = 0.;
+#ifdef AOPT_SPRING_SIMD_X86
+            if(_isa == AVX512)
+                return _with_length ? energy_avx512<true>(_x, _i0, _i1, _k, _l, _n, _energy, nullptr)
+                                    : energy_avx512<false>(_x, _i0, _i1, _k, _l, _n, _energy, nullptr);
+            if(_isa == AVX2)
+                return _with_length ? energy_avx2<true>(_x, _i0, _i1, _k, _l, _n, _energy, nullptr)
+                                    : energy_avx2<false>(_x, _i0, _i1, _k, _l, _n, _energy, nullptr);
+#endif
+            return 0;
+        }
+
+        /** energy of the springs and their gradient, which is added to _g
+         * \return the number of processed springs */
+        static size_t energy_and_gradient(const Isa _isa, const bool _with_length, const double* _x,
+                                          const int* _i0, const int* _i1, const double* _k, const double* _l,
+                                          const size_t _n, double& _energy, double* _g) {
+            _energy = 0.;
+#ifdef AOPT_SPRING_SIMD_X86
+            if(_isa == AVX512)
+                return _with_length ? energy_avx512<true>(_x, _i0, _i1, _k, _l, _n, _energy, _g)
+                                    : energy_avx512<false>(_x, _i0, _i1, _k, _l, _n, _energy, _g);
+            if(_isa == AVX2)
+                return _with_length ? energy_avx2<true>(_x, _i0, _i1, _k, _l, _n, _energy, _g)
+                                    : energy_avx2<false>(_x, _i0, _i1, _k, _l, _n, _energy, _g);
+#endif
+            return 0;
+        }
+
+    private:
+        static Isa detect_isa() {
+#ifdef AOPT_SPRING_SIMD_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f"))
+                return AVX512;
+            if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return AVX2;
+#endif
+            return SCALAR;
+        }
+
+#ifdef AOPT_SPRING_SIMD_X86
+        // adds the per-spring gradients (gx, gy) of a batch of W springs
+        template<int W>
+        static inline void scatter_gradient(const int* _i0, const int* _i1,
+                                            const double* _gx, const double* _gy, double* _g) {
+            for(int j = 0; j < W; ++j) {
+                _g[2 * _i0[j]] += _gx[j];
+                _g[2 * _i0[j] + 1] += _gy[j];
+                _g[2 * _i1[j]] -= _gx[j];
+                _g[2 * _i1[j] + 1] -= _gy[j];
+            }
+        }
+
+        // gathers of the coordinates _base[_index[j]], masked with a full mask from a zeroed
+        // source since the unmasked gathers start from an undefined register, which GCC
+        // reports as maybe uninitialized
+        __attribute__((target("avx2")))
+        static inline __m256d gather4(const double* _base, const __m128i _index) {
+            return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), _base, _index,
+                                            _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+        }
+
+        __attribute__((target("avx512f")))
+        static inline __m512d gather8(const double* _base, const __m256i _index) {
+            return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, _index, _base, 8);
+        }
+
+        /* energy (and gradient if _g != nullptr) of 4 springs per iteration.
+         * E = 1/2 k d^2 resp. 1/2 k (d^2 - l^2)^2 and the gradient w.r.t. the first
+         * node is c * (dx, dy) with c = k resp. 2k (d^2 - l^2) */
+        template<bool WithLength>
+        __attribute__((target("avx2,fma")))
+        static size_t energy_avx2(const double* _x, const int* _i0, const int* _i1,
+                                  const double* _k, const double* _l, const size_t _n,
+                                  double& _energy, double* _g) {
+            const size_t n_batch = _n - _n % 4;
+            const __m256d half = _mm256_set1_pd(0.5);
+            const __m256d two = _mm256_set1_pd(2.0);
+            __m256d acc = _mm256_setzero_pd();
+            alignas(32) double gx[4], gy[4];
+
+            for(size_t i = 0; i < n_batch; i += 4) {
+                // indices of the x coordinates, i.e. 2 * node index
+                __m128i a = _mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_i0 + i)), 1);
+                __m128i b = _mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_i1 + i)), 1);
+
+                __m256d dx = _mm256_sub_pd(gather4(_x, a), gather4(_x, b));
+                __m256d dy = _mm256_sub_pd(gather4(_x + 1, a), gather4(_x + 1, b));
+                __m256d d2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+                __m256d k = _mm256_loadu_pd(_k + i);
+
+                __m256d c;
+                if(WithLength) {
+                    __m256d l = _mm256_loadu_pd(_l + i);
+                    __m256d r = _mm256_fnmadd_pd(l, l, d2);
+                    acc = _mm256_fmadd_pd(_mm256_mul_pd(half, k), _mm256_mul_pd(r, r), acc);
+                    c = _mm256_mul_pd(_mm256_mul_pd(two, k), r);
+                } else {
+                    acc = _mm256_fmadd_pd(_mm256_mul_pd(half, k), d2, acc);
+                    c = k;
+                }
+
+                if(_g != nullptr) {
+                    _mm256_store_pd(gx, _mm256_mul_pd(c, dx));
+                    _mm256_store_pd(gy, _mm256_mul_pd(c, dy));
+                    scatter_gradient<4>(_i0 + i, _i1 + i, gx, gy, _g);
+                }
+            }
+
+            // horizontal reduction of the 4 lanes
+            __m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+            _energy = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+
+            return n_batch;
+        }
+
+        // same as energy_avx2 with 8 springs per iteration
+        template<bool WithLength>
+        __attribute__((target("avx512f")))
+        static size_t energy_avx512(const double* _x, const int* _i0, const int* _i1,
+                                    const double* _k, const double* _l, const size_t _n,
+                                    double& _energy, double* _g) {
+            const size_t n_batch = _n - _n % 8;
+            const __m512d half = _mm512_set1_pd(0.5);
+            const __m512d two = _mm512_set1_pd(2.0);
+            __m512d acc = _mm512_setzero_pd();
+            alignas(64) double gx[8], gy[8];
+
+            for(size_t i = 0; i < n_batch; i += 8) {
+                __m256i a = _mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_i0 + i)), 1);
+                __m256i b = _mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_i1 + i)), 1);
+
+                __m512d dx = _mm512_sub_pd(gather8(_x, a), gather8(_x, b));
+                __m512d dy = _mm512_sub_pd(gather8(_x + 1, a), gather8(_x + 1, b));
+                __m512d d2 = _mm512_fmadd_pd(dx, dx, _mm512_mul_pd(dy, dy));
+                __m512d k = _mm512_loadu_pd(_k + i);
+
+                __m512d c;
+                if(WithLength) {
+                    __m512d l = _mm512_loadu_pd(_l + i);
+                    __m512d r = _mm512_fnmadd_pd(l, l, d2);
+                    acc = _mm512_fmadd_pd(_mm512_mul_pd(half, k), _mm512_mul_pd(r, r), acc);
+                    c = _mm512_mul_pd(_mm512_mul_pd(two, k), r);
+                } else {
+                    acc = _mm512_fmadd_pd(_mm512_mul_pd(half, k), d2, acc);
+                    c = k;
+                }
+
+                if(_g != nullptr) {
+                    _mm512_store_pd(gx, _mm512_mul_pd(c, dx));
+                    _mm512_store_pd(gy, _mm512_mul_pd(c, dy));
+                    scatter_gradient<8>(_i0 + i, _i1 + i, gx, gy, _g);
+                }
+            }
+
+            // horizontal reduction of the 8 lanes, as _mm512_reduce_add_pd but with masked
+            // extractions of the halves, whose unmasked forms warn as the gathers do
+            __m256d h = _mm256_add_pd(_mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, acc, 0),
+                                      _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, acc, 1));
+            __m128d s = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+            _energy = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+
+            return n_batch;
+        }
+#endif
+    };
+
+    /* Tells MassSpringProblem2DSparseT which SIMD kernel matches a spring element.
+     * Elements without a specialization always use their scalar kernels. */
+    template<class Element>
+    struct SpringKernelSIMDTraits {
+        static const bool available = false;
+        static const bool with_length = false;
+    };
+
+    template<>
+    struct SpringKernelSIMDTraits<SpringElement2D> {
+        static const bool available = true;
+        static const bool with_length = false;
+    };
+
+    template<>
+    struct SpringKernelSIMDTraits<SpringElement2DWithLength> {
+        static const bool available = true;
+        static const bool with_length = true;
+    };
+
+    template<>
+    struct SpringKernelSIMDTraits<SpringElement2DWithLengthPSDHessian> {
+        static const bool available = true;
+        static const bool with_length = true;
+    };
+
+//=============================================================================
+}
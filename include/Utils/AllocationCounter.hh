@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+//== CLASS DEFINITION =========================================================
+
+    /* Opt-in global heap allocation counter.
+     *
+     * The counting hook, which replaces the global operator new, is defined in
+     * AllocationCounterHook.hh and is installed by including that header in exactly
+     * one source file of the program.
+     *
+     * Without the hook, installed() is false and the counter stays at 0. */
+    class AllocationCounter {
+    public:
+        // number of heap allocations since the start of the program or the last reset
+        static long n_allocations() {
+            return counter().load(std::memory_order_relaxed);
+        }
+
+        static void reset() {
+            counter().store(0, std::memory_order_relaxed);
+        }
+
+        // true if the counting hook is part of the program
+        static bool installed() {
+            return installed_flag().load(std::memory_order_relaxed);
+        }
+
+        // called by the hook
+        static void count() {
+            counter().fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static bool mark_installed() {
+            installed_flag().store(true, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        // constant-initialized, hence usable by allocations happening before main
+        static std::atomic<long>& counter() {
+            static std::atomic<long> n(0);
+            return n;
+        }
+
+        static std::atomic<bool>& installed_flag() {
+            static std::atomic<bool> installed(false);
+            return installed;
+        }
+    };
+
+//=============================================================================
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+/* Counting hook of AllocationCounter, to be included in exactly one source file
+ * of a program, since it defines the replacements of the global allocation functions.
+ *
+ * Eigen allocates its dynamic vectors and matrices with std::malloc rather than
+ * operator new, so with glibc the hook also interposes malloc, calloc and realloc.
+ * The over-aligned operator new (std::align_val_t, from C++17) is replaced and counted
+ * as well.
+ *
+ * With glibc, the replaced operator delete frees through __libc_free, the counterpart
+ * of the __libc_malloc of operator new, also so that GCC does not see std::free
+ * applied to memory from operator new (-Wmismatched-new-delete). */
+
+#include "AllocationCounter.hh"
+
+#if defined(__GLIBC__)
+extern "C" {
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+
+    void* malloc(size_t _size) {
+        AOPT::AllocationCounter::count();
+        return __libc_malloc(_size);
+    }
+
+    void* calloc(size_t _n, size_t _size) {
+        AOPT::AllocationCounter::count();
+        return __libc_calloc(_n, _size);
+    }
+
+    void* realloc(void* _ptr, size_t _size) {
+        AOPT::AllocationCounter::count();
+        return __libc_realloc(_ptr, _size);
+    }
+}
+#define AOPT_ALLOCATION_COUNTER_MALLOC(_size) __libc_malloc(_size)
+#define AOPT_ALLOCATION_COUNTER_ALIGNED_ALLOC(_alignment, _size) __libc_memalign(_alignment, _size)
+#define AOPT_ALLOCATION_COUNTER_FREE(_ptr) __libc_free(_ptr)
+#else
+#define AOPT_ALLOCATION_COUNTER_MALLOC(_size) std::malloc(_size)
+// std::aligned_alloc needs a size multiple of the alignment
+#define AOPT_ALLOCATION_COUNTER_ALIGNED_ALLOC(_alignment, _size) \
+    std::aligned_alloc((_alignment), ((_size) + (_alignment) - 1) / (_alignment) * (_alignment))
+#define AOPT_ALLOCATION_COUNTER_FREE(_ptr) std::free(_ptr)
+#endif
+
+void* operator new(std::size_t _size) {
+    AOPT::AllocationCounter::count();
+    if(void* ptr = AOPT_ALLOCATION_COUNTER_MALLOC(_size == 0 ? 1 : _size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t _size) {
+    return operator new(_size);
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t _size, std::align_val_t _alignment) {
+    AOPT::AllocationCounter::count();
+    if(void* ptr = AOPT_ALLOCATION_COUNTER_ALIGNED_ALLOC(static_cast<std::size_t>(_alignment), _size == 0 ? 1 : _size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t _size, std::align_val_t _alignment) {
+    return operator new(_size, _alignment);
+}
+#endif
+
+void operator delete(void* _ptr) noexcept {
+    AOPT_ALLOCATION_COUNTER_FREE(_ptr);
+}
+
+void operator delete[](void* _ptr) noexcept {
+    AOPT_ALLOCATION_COUNTER_FREE(_ptr);
+}
+
+void operator delete(void* _ptr, std::size_t) noexcept {
+    AOPT_ALLOCATION_COUNTER_FREE(_ptr);
+}
+
+void operator delete[](void* _ptr, std::size_t) noexcept {
+    AOPT_ALLOCATION_COUNTER_FREE(_ptr);
+}
+
+#ifdef __cpp_aligned_new
+void operator delete(void* _ptr, std::align_val_t) noexcept {
+    AOPT_ALLOCATION_COUNTER_FREE(_ptr);
+}
+
+void operator delete[](void* _ptr, std::align_val_t) noexcept {
+    AOPT_ALLOCATION_COUNTER_FREE(_ptr);
+}
+
+void operator delete(void* _ptr, std::size_t, std::align_val_t) noexcept {
+    AOPT_ALLOCATION_COUNTER_FREE(_ptr);
+}
+
+void operator delete[](void* _ptr, std::size_t, std::align_val_t) noexcept {
+    AOPT_ALLOCATION_COUNTER_FREE(_ptr);
+}
+#endif
+
+static const bool aopt_allocation_counter_installed = AOPT::AllocationCounter::mark_installed();
+
+#undef AOPT_ALLOCATION_COUNTER_MALLOC
+#undef AOPT_ALLOCATION_COUNTER_ALIGNED_ALLOC
+#undef AOPT_ALLOCATION_COUNTER_FREE
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+//== CLASS DEFINITION =========================================================
+
+    /* Symmetric n x n matrix whose non-zeros satisfy |i - j| <= kd, kd being the
+     * (half) bandwidth. Only the lower band is stored, as in LAPACK's 'L' band storage:
+     * band()(i - j, j) = A(i, j) for j <= i <= min(n - 1, j + kd).
+     * Each column of the band is contiguous, and the storage is (kd + 1) * n
+     * instead of n * n. */
+    class BandedSymmetricMatrix {
+    public:
+        using Vec = Eigen::VectorXd;
+        using Mat = Eigen::MatrixXd;
+
+        BandedSymmetricMatrix() : kd_(0) {}
+
+        BandedSymmetricMatrix(const int _n, const int _kd) {
+            resize(_n, _kd);
+        }
+
+        // resizes and sets all the entries to 0
+        void resize(const int _n, const int _kd) {
+            kd_ = _kd;
+            band_.resize(_kd + 1, _n);
+            band_.setZero();
+        }
+
+        void setZero() { band_.setZero(); }
+
+        int rows() const { return static_cast<int>(band_.cols()); }
+        int cols() const { return rows(); }
+        int bandwidth() const { return kd_; }
+
+        /** entry (_i, _j) of the lower band, i.e. _j <= _i <= _j + kd.
+         * Assembling there also sets the symmetric entry (_j, _i) */
+        double& lower(const int _i, const int _j) { return band_(_i - _j, _j); }
+        double lower(const int _i, const int _j) const { return band_(_i - _j, _j); }
+
+        // entry (_i, _j) of the full matrix, 0 outside of the band
+        double operator()(const int _i, const int _j) const {
+            const int i = std::max(_i, _j), j = std::min(_i, _j);
+            return i - j <= kd_ ? band_(i - j, j) : 0.;
+        }
+
+        // the band storage, (kd + 1) x n
+        Mat& band() { return band_; }
+        const Mat& band() const { return band_; }
+
+        Mat to_dense() const {
+            const int n = rows();
+            Mat A = Mat::Zero(n, n);
+            for(int j = 0; j < n; ++j)
+                for(int r = 0; r <= kd_ && j + r < n; ++r)
+                    A(j + r, j) = A(j, j + r) = band_(r, j);
+            return A;
+        }
+
+        // _y = A * _x
+        void multiply(const Vec& _x, Vec& _y) const {
+            const int n = rows();
+            _y.setZero(n);
+            for(int j = 0; j < n; ++j) {
+                _y[j] += band_(0, j) * _x[j];
+                for(int r = 1; r <= kd_ && j + r < n; ++r) {
+                    _y[j + r] += band_(r, j) * _x[j];
+                    _y[j] += band_(r, j) * _x[j + r];
+                }
+            }
+        }
+
+        // Frobenius norm of the full symmetric matrix
+        double norm() const {
+            const double diagonal = band_.row(0).squaredNorm();
+            return std::sqrt(2. * band_.squaredNorm() - diagonal);
+        }
+
+    private:
+        int kd_;
+        Mat band_;
+    };
+
+
+    /* Cholesky factorization A = L L^T of a positive definite BandedSymmetricMatrix.
+     * L has the same bandwidth as A, so the factorization costs O(n kd^2) and is
+     * stored in the same band layout (as LAPACK's dpbtrf with 'L'). */
+    class BandedCholesky {
+    public:
+        using Vec = Eigen::VectorXd;
+
+        BandedCholesky() : success_(false) {}
+
+        /** factorizes _A
+         * \return false if _A is not (numerically) positive definite, in which case
+         * solve should not be used */
+        bool compute(const BandedSymmetricMatrix& _A) {
+            L_ = _A;
+            auto& L = L_.band();
+            const int n = L_.rows();
+            const int kd = L_.bandwidth();
+
+            success_ = false;
+            for(int j = 0; j < n; ++j) {
+                double ljj = L(0, j);
+                if(!(ljj > 0.))
+                    return false;
+                ljj = std::sqrt(ljj);
+                L(0, j) = ljj;
+
+                // scale the column below the diagonal
+                const int kn = std::min(kd, n - 1 - j);
+                for(int r = 1; r <= kn; ++r)
+                    L(r, j) /= ljj;
+
+                // rank-1 update of the trailing kn x kn block
+                for(int c = 1; c <= kn; ++c) {
+                    const double lc = L(c, j);
+                    for(int r = c; r <= kn; ++r)
+                        L(r - c, j + c) -= L(r, j) * lc;
+                }
+            }
+
+            success_ = true;
+            return true;
+        }
+
+        bool success() const { return success_; }
+
+        // solves A _x = _b, _x and _b may be the same vector
+        void solve(const Vec& _b, Vec& _x) const {
+            const auto& L = L_.band();
+            const int n = L_.rows();
+            const int kd = L_.bandwidth();
+
+            _x = _b;
+            // L y = b
+            for(int j = 0; j < n; ++j) {
+                _x[j] /= L(0, j);
+                const int kn = std::min(kd, n - 1 - j);
+                for(int r = 1; r <= kn; ++r)
+                    _x[j + r] -= L(r, j) * _x[j];
+            }
+            // L^T x = y
+            for(int j = n - 1; j >= 0; --j) {
+                const int kn = std::min(kd, n - 1 - j);
+                double s = _x[j];
+                for(int r = 1; r <= kn; ++r)
+                    s -= L(r, j) * _x[j + r];
+                _x[j] = s / L(0, j);
+            }
+        }
+
+    private:
+        BandedSymmetricMatrix L_;
+        bool success_;
+    };
+
+//=============================================================================
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <FunctionBase/FunctionBase.hh>
+#include <Utils/RandomNumberGenerator.hh>
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+    //== CLASS DEFINITION =========================================================
+
+    /* Estimates the Lipschitz constant L of the gradient at a point, i.e. the largest
+     * eigenvalue of the Hessian, from Hessian-vector products only (eval_hessian_vector).
+     *
+     * k steps of the Lanczos method from a random vector give a k x k tridiagonal matrix
+     * whose largest eigenvalue theta (a Ritz value) is a lower bound of the largest
+     * eigenvalue, converging much faster than the power iteration with the same number
+     * of products. Since an underestimated L gives too long steps, the estimate is
+     * theta + |beta_k s_k|, the residual norm of the Ritz pair, which bounds the distance
+     * of theta to an eigenvalue of the Hessian. */
+    class LipschitzEstimator {
+    public:
+        using Vec = FunctionBase::Vec; ///< Eigen::VectorXd
+        using Mat = FunctionBase::Mat; ///< Eigen::MatrixXd
+
+        /**
+         * \param _problem a pointer to a specific Problem, which can be any type that
+         *        has the same interface as FunctionBase's, with eval_hessian_vector
+         * \param _x the point at which the Hessian is evaluated
+         * \param _n_iters the number of Lanczos steps, i.e. of Hessian-vector products
+         * \return the estimate of the largest eigenvalue of the Hessian at _x */
+        template <class Problem>
+        static double largest_eigenvalue(Problem *_problem, const Vec &_x, const int _n_iters = 20) {
+            const int n = _problem->n_unknowns();
+            RandomNumberGenerator rng(-1., 1.);
+            Vec v = rng.get_random_nd_vector(n);
+            v.normalize();
+            Vec v_prev = Vec::Zero(n), w(n);
+
+            // diagonal and off-diagonal of the tridiagonal matrix
+            std::vector<double> alpha, beta;
+            double b = 0.;
+            for (int j = 0; j < std::min(_n_iters, n); ++j) {
+                _problem->eval_hessian_vector(_x, v, w);
+                const double a = v.dot(w);
+                w -= a * v + b * v_prev;
+                alpha.push_back(a);
+                b = w.norm();
+                beta.push_back(b);
+                // invariant subspace, theta is an eigenvalue
+                if (b <= 1e-12 * std::abs(a))
+                    break;
+
+                v_prev.swap(v);
+                v = w / b;
+            }
+
+            const int k = alpha.size();
+            if (k == 0)
+                return 0.;
+            Mat T = Mat::Zero(k, k);
+            for (int j = 0; j < k; ++j) {
+                T(j, j) = alpha[j];
+                if (j + 1 < k)
+                    T(j, j + 1) = T(j + 1, j) = beta[j];
+            }
+
+            // eigenvalues in increasing order
+            Eigen::SelfAdjointEigenSolver<Mat> es(T);
+            const double theta = es.eigenvalues()[k - 1];
+            return theta + std::abs(beta[k - 1] * es.eigenvectors()(k - 1, k - 1));
+        }
+    };
+}
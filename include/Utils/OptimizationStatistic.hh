@@ -5,6 +5,7 @@
 #include <FunctionBase/FunctionBaseSparse.hh>
 
 #include "StopWatch.hh"
+#include "AllocationCounter.hh"
 
 //== NAMESPACES ===============================================================
 
@@ -46,47 +47,126 @@ namespace AOPT {
             timing_eval_hessian_ += sw_.stop();
         }
 
+        virtual double eval_f_and_gradient(const Vec &_x, Vec &_g) override {
+            ++n_eval_f_and_gradient_;
+            sw_.start();
+            double f = base_->eval_f_and_gradient(_x, _g);
+            timing_eval_f_and_gradient_ += sw_.stop();
+
+            return f;
+        }
+
+        virtual void eval_hessian_vector(const Vec &_x, const Vec &_v, Vec &_hv) override {
+            ++n_eval_hessian_vector_;
+            sw_.start();
+            base_->eval_hessian_vector(_x, _v, _hv);
+            timing_eval_hessian_vector_ += sw_.stop();
+        }
+
+        virtual bool has_concurrent_eval_f() override {
+            return base_->has_concurrent_eval_f();
+        }
+
+        virtual void reserve_concurrent_eval_f(const int _n_slots) override {
+            base_->reserve_concurrent_eval_f(_n_slots);
+        }
+
+        // only counted, the concurrent evaluations overlapping in time
+        virtual double eval_f_concurrent(const Vec &_x, const int _slot) override {
+#pragma omp atomic
+            ++n_eval_f_concurrent_;
+            return base_->eval_f_concurrent(_x, _slot);
+        }
+
+        virtual bool line_polynomial(const Vec &_x, const Vec &_d, Vec &_p) override {
+            ++n_line_polynomial_;
+            sw_.start();
+            const bool is_polynomial = base_->line_polynomial(_x, _d, _p);
+            timing_line_polynomial_ += sw_.stop();
+
+            return is_polynomial;
+        }
+
         void start_recording() {
             swg_.start();
 
             timing_eval_f_ = 0.0;
             timing_eval_gradient_ = 0.0;
             timing_eval_hessian_ = 0.0;
+            timing_eval_f_and_gradient_ = 0.0;
+            timing_eval_hessian_vector_ = 0.0;
+            timing_line_polynomial_ = 0.0;
 
             n_eval_f_ = 0;
             n_eval_gradient_ = 0;
             n_eval_hessian_ = 0;
+            n_eval_f_and_gradient_ = 0;
+            n_eval_hessian_vector_ = 0;
+            n_line_polynomial_ = 0;
+            n_eval_f_concurrent_ = 0;
+
+            n_allocations_start_ = AllocationCounter::n_allocations();
         }
 
         void print_statistics() {
             double time_total = swg_.stop();
 
-            double time_np = timing_eval_f_ + timing_eval_gradient_ + timing_eval_hessian_;
+            double time_np = timing_eval_f_ + timing_eval_gradient_ + timing_eval_hessian_ + timing_eval_f_and_gradient_
+                             + timing_eval_hessian_vector_ + timing_line_polynomial_;
 
 
             std::cerr << "######## Timing statistics ########" << std::endl;
             std::cerr << "total time    : " << time_total / 1000000.0 << "s\n";
             std::cerr << "total time evaluation : " << time_np / 1000000.0 << "s  (" << time_np / time_total * 100.0 << " %)\n";
 
-            double timing_eval_f_avg = timing_eval_f_ / double(n_eval_f_);
-            double timing_eval_gradient_avg = timing_eval_gradient_ / double(n_eval_gradient_);
-            double timing_eval_hessian_avg = timing_eval_hessian_ / double(n_eval_hessian_);
-
-            std::cerr << std::fixed << std::setprecision(5)
-                      << "eval_f time   : " << timing_eval_f_ / 1000000.0
-                      << "s  ( #evals: " << n_eval_f_ << " -> avg "
-                      << timing_eval_f_avg / 1000000.0 << "s )\n"
-                      << "eval_grad time: " << timing_eval_gradient_ / 1000000.0
-                      << "s  ( #evals: " << n_eval_gradient_ << " -> avg "
-                      << timing_eval_gradient_avg / 1000000.0 << "s, factor: "
-                      << timing_eval_gradient_avg / timing_eval_f_avg << ")\n"
-                      << "eval_hess time: " << timing_eval_hessian_ / 1000000.0
-                      << "s  ( #evals: " << n_eval_hessian_ << " -> avg "
-                      << timing_eval_hessian_avg / 1000000.0 << "s, factor: "
-                      << timing_eval_hessian_avg / timing_eval_f_avg << ")\n";
+            // the factors are relative to eval_f, or to eval_f+g for the solvers which only
+            // evaluate f together with the gradient
+            const bool reference_f = n_eval_f_ > 0 || n_eval_f_and_gradient_ == 0;
+            const double reference_avg = reference_f ? average(timing_eval_f_, n_eval_f_)
+                                                     : average(timing_eval_f_and_gradient_, n_eval_f_and_gradient_);
+
+            std::cerr << std::fixed << std::setprecision(5);
+            print_timing("eval_f time   : ", timing_eval_f_, n_eval_f_, reference_f ? 0. : reference_avg);
+            print_timing("eval_grad time: ", timing_eval_gradient_, n_eval_gradient_, reference_avg);
+            print_timing("eval_hess time: ", timing_eval_hessian_, n_eval_hessian_, reference_avg);
+            print_timing("eval_f+g time : ", timing_eval_f_and_gradient_, n_eval_f_and_gradient_,
+                         reference_f ? reference_avg : 0.);
+
+            // only printed for the solvers using them, see eval_hessian_vector and line_polynomial
+            if(n_eval_hessian_vector_ > 0)
+                print_timing("eval_Hv time  : ", timing_eval_hessian_vector_, n_eval_hessian_vector_, reference_avg);
+            if(n_line_polynomial_ > 0)
+                print_timing("line poly time: ", timing_line_polynomial_, n_line_polynomial_, reference_avg);
+            if(!reference_f && n_eval_gradient_ + n_eval_hessian_ + n_eval_hessian_vector_ + n_line_polynomial_ > 0)
+                std::cerr << "(factors relative to eval_f+g)\n";
+
+            if(n_eval_f_concurrent_ > 0)
+                std::cerr << "concurrent eval_f: " << n_eval_f_concurrent_ << " evals\n";
+
+            // only known if the program installed the hook, see AllocationCounter
+            if(AllocationCounter::installed())
+                std::cerr << "heap allocations: " << AllocationCounter::n_allocations() - n_allocations_start_ << "\n";
         }
 
     private:
+        // average time of _n evaluations, 0 without evaluations
+        static double average(const double _timing, const int _n) {
+            return _n > 0 ? _timing / double(_n) : 0.;
+        }
+
+        /** prints the total time of _n evaluations, and if there were some, their average
+         * time and its ratio to _reference_avg if it is positive */
+        static void print_timing(const char* _label, const double _timing, const int _n, const double _reference_avg) {
+            std::cerr << _label << _timing / 1000000.0 << "s  ( #evals: " << _n;
+            if(_n > 0) {
+                const double avg = _timing / double(_n);
+                std::cerr << " -> avg " << avg / 1000000.0 << "s";
+                if(_reference_avg > 0.)
+                    std::cerr << ", factor: " << avg / _reference_avg;
+            }
+            std::cerr << " )\n";
+        }
+
         FunctionBaseSparse *base_;
         AOPT::StopWatch<std::chrono::microseconds> swg_;
         AOPT::StopWatch<std::chrono::microseconds> sw_;
@@ -95,11 +175,21 @@ namespace AOPT {
         double timing_eval_f_;
         double timing_eval_gradient_;
         double timing_eval_hessian_;
+        double timing_eval_f_and_gradient_;
+        double timing_eval_hessian_vector_;
+        double timing_line_polynomial_;
 
         // number of function executions
         int n_eval_f_;
         int n_eval_gradient_;
         int n_eval_hessian_;
+        int n_eval_f_and_gradient_;
+        int n_eval_hessian_vector_;
+        int n_line_polynomial_;
+        int n_eval_f_concurrent_;
+
+        // allocation count when the recording started
+        long n_allocations_start_;
     };
 
 //=============================================================================
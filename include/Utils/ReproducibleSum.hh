@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+//== NAMESPACES ===============================================================
+
+namespace AOPT {
+
+//== CLASS DEFINITION =========================================================
+
+    /* Helpers to sum many terms (e.g. spring energies) in parallel while getting
+     * bitwise identical results for any number of threads.
+     *
+     * The terms are split into chunks of a fixed size, which only depends on the
+     * number of terms. Each chunk is summed sequentially, by whichever thread, and the
+     * chunk sums are then reduced with a fixed pairwise tree. Hence the order of the
+     * floating point additions never depends on the thread scheduling.
+     *
+     * With at most one chunk, the result is the plain sequential sum. */
+    class ReproducibleSum {
+    public:
+        // number of terms per chunk, a multiple of the SIMD widths of SpringKernelsSIMD
+        static const size_t chunk_size = 1024;
+
+        static size_t n_chunks(const size_t _n_terms) {
+            return (_n_terms + chunk_size - 1) / chunk_size;
+        }
+
+        // first term of the chunk _c, the chunk ends where the next one starts
+        static size_t chunk_begin(const size_t _c, const size_t _n_terms) {
+            return std::min(_c * chunk_size, _n_terms);
+        }
+
+        /** pairwise sum of _n values, splitting the range in two halves recursively
+         * \return 0 if _n == 0 */
+        static double pairwise_sum(const double* _v, const size_t _n) {
+            if(_n == 0)
+                return 0.;
+            if(_n == 1)
+                return _v[0];
+
+            const size_t half = _n / 2;
+            return pairwise_sum(_v, half) + pairwise_sum(_v + half, _n - half);
+        }
+
+        static double pairwise_sum(const std::vector<double>& _v) {
+            return pairwise_sum(_v.data(), _v.size());
+        }
+
+        /** pairwise sum of the sums _chunk_sum(c) of the chunks c in [_begin, _end), with the
+         * same tree as pairwise_sum, for callers which do not store the chunk sums
+         * \return 0 if _end <= _begin */
+        template<class ChunkSum>
+        static double pairwise_sum_of_chunks(const ChunkSum& _chunk_sum, const size_t _begin, const size_t _end) {
+            if(_end <= _begin)
+                return 0.;
+            if(_end - _begin == 1)
+                return _chunk_sum(_begin);
+
+            const size_t half = (_end - _begin) / 2;
+            return pairwise_sum_of_chunks(_chunk_sum, _begin, _begin + half)
+                   + pairwise_sum_of_chunks(_chunk_sum, _begin + half, _end);
+        }
+    };
+
+//=============================================================================
+}